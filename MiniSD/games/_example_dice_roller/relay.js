@@ -0,0 +1,191 @@
+// LAN Party Arcade relay helpers
+//
+// Binary envelope: every binary frame starts with a fixed 8-byte header
+// that the ESP32 routes on without parsing anything else.
+//
+//   byte 0    version (1)
+//   byte 1    message type (your game decides what these mean)
+//   byte 2    flags (bit 0 = targeted, bit 1 = deflated text from the relay)
+//   byte 3    target clientNum (only used when targeted)
+//   byte 4    source clientNum (filled in by the relay)
+//   byte 5    reserved
+//   byte 6-7  sequence number (little-endian, passed through untouched)
+//
+// Remember to set ws.binaryType = 'arraybuffer' before receiving.
+
+const RelayBinary = {
+    HEADER_SIZE: 8,
+    VERSION: 1,
+    FLAG_TARGETED: 0x01,
+    FLAG_DEFLATE: 0x02,
+
+    // Build a frame. body can be an ArrayBuffer, a typed array or omitted.
+    // options.target = clientNum to send to one player only
+    // options.seq    = sequence number (0-65535)
+    encode(type, body, options = {}) {
+        const bytes = body ? new Uint8Array(body.buffer || body, body.byteOffset || 0, body.byteLength) : new Uint8Array(0);
+        const frame = new Uint8Array(this.HEADER_SIZE + bytes.length);
+        const targeted = options.target !== undefined;
+
+        frame[0] = this.VERSION;
+        frame[1] = type;
+        frame[2] = targeted ? this.FLAG_TARGETED : 0;
+        frame[3] = targeted ? options.target : 0;
+        frame[6] = (options.seq || 0) & 0xFF;
+        frame[7] = ((options.seq || 0) >> 8) & 0xFF;
+        frame.set(bytes, this.HEADER_SIZE);
+        return frame.buffer;
+    },
+
+    // Split a received frame into header fields and body (a DataView)
+    decode(buffer) {
+        const frame = new Uint8Array(buffer);
+        if (frame.length < this.HEADER_SIZE || frame[0] !== this.VERSION) {
+            return null;
+        }
+        return {
+            type: frame[1],
+            flags: frame[2],
+            target: frame[3],
+            source: frame[4],
+            seq: frame[6] | (frame[7] << 8),
+            body: new DataView(buffer, this.HEADER_SIZE)
+        };
+    }
+};
+
+// Delta state: with "relayDeltaState" on, snapshots from the host arrive as
+// relay_keyframe (full state) or relay_delta (JSON merge patch) messages.
+// Feed every message through RelayState.receive(); it returns the full host
+// message once it has one, or null for messages that aren't state.
+const RelayState = {
+    version: -1,
+    state: null,
+
+    receive(msg, ws) {
+        if (msg.type === 'relay_keyframe') {
+            this.version = msg.v;
+            this.state = msg.state;
+            return this.state;
+        }
+        if (msg.type !== 'relay_delta') {
+            return null;
+        }
+        if (msg.base !== this.version || this.state === null) {
+            // Missed a patch (or joined mid-stream): ask for the full state
+            ws.send(JSON.stringify({ type: 'relay_resync' }));
+            return null;
+        }
+        this.state = this.applyPatch(this.state, msg.patch);
+        this.version = msg.v;
+        return this.state;
+    },
+
+    // RFC 7386: null removes a key, objects merge, everything else replaces
+    applyPatch(target, patch) {
+        if (patch === null || typeof patch !== 'object' || Array.isArray(patch)) {
+            return patch;
+        }
+        if (target === null || typeof target !== 'object' || Array.isArray(target)) {
+            target = {};
+        }
+        for (const key of Object.keys(patch)) {
+            if (patch[key] === null) {
+                delete target[key];
+            } else {
+                target[key] = this.applyPatch(target[key], patch[key]);
+            }
+        }
+        return target;
+    }
+};
+
+// Clock sync: the relay answers { type: 'relay_ping', t0 } with
+// { type: 'relay_pong', t0, t1, t2 } where t1/t2 are the server's receive and
+// send times in microseconds since boot. Messages sent with stamp: true
+// arrive with serverTime (same clock) added by the relay.
+//
+//   RelayClock.sync(ws);                       // after connecting
+//   if (RelayClock.receive(data)) return;      // in your message handler
+//   RelayClock.toLocal(data.serverTime);       // server time -> performance.now()
+const RelayClock = {
+    offset: 0,          // server ms - local ms
+    rtt: Infinity,      // best round trip seen (ms)
+    samples: [],
+
+    ping(ws) {
+        ws.send(JSON.stringify({ type: 'relay_ping', t0: performance.now() }));
+    },
+
+    // Send a few pings; the one with the lowest RTT gives the best offset
+    sync(ws, count = 8, interval = 100) {
+        for (let i = 0; i < count; i++) {
+            setTimeout(() => this.ping(ws), i * interval);
+        }
+    },
+
+    // Returns true if msg was a pong (and has been consumed)
+    receive(msg) {
+        if (msg.type !== 'relay_pong' || typeof msg.t0 !== 'number') {
+            return false;
+        }
+        const t3 = performance.now();
+        const t1 = msg.t1 / 1000;
+        const t2 = msg.t2 / 1000;
+        const sample = {
+            rtt: (t3 - msg.t0) - (t2 - t1),
+            offset: ((t1 - msg.t0) + (t2 - t3)) / 2
+        };
+
+        this.samples.push(sample);
+        if (this.samples.length > 8) {
+            this.samples.shift();
+        }
+        const best = this.samples.reduce((a, b) => (b.rtt < a.rtt ? b : a));
+        this.rtt = best.rtt;
+        this.offset = best.offset;
+        return true;
+    },
+
+    // Current time on the server clock, in ms
+    serverNow() {
+        return performance.now() + this.offset;
+    },
+
+    // A serverTime (µs) from a stamped message, on the local performance.now() clock
+    toLocal(serverTime) {
+        return serverTime / 1000 - this.offset;
+    }
+};
+
+// Compressed broadcasts: connect with ?deflate=1 (only if the browser has
+// DecompressionStream) and large room broadcasts may arrive as binary frames
+// holding deflated JSON text. Inflating is asynchronous, so route every
+// message through RelayDeflate.receive() to keep them in arrival order:
+//
+//   ws = new WebSocket(`ws://${host}:81/?deflate=${RelayDeflate.supported ? 1 : 0}`);
+//   ws.binaryType = 'arraybuffer';
+//   ws.onmessage = (event) => RelayDeflate.receive(event.data, onText, onBinary);
+const RelayDeflate = {
+    supported: typeof DecompressionStream !== 'undefined',
+    chain: Promise.resolve(),
+
+    // onText(string) gets text messages (inflated or not), onBinary(buffer)
+    // gets your game's own binary frames
+    receive(data, onText, onBinary) {
+        this.chain = this.chain.then(async () => {
+            if (typeof data === 'string') {
+                return onText(data);
+            }
+            const frame = new Uint8Array(data);
+            if (frame.length >= RelayBinary.HEADER_SIZE && (frame[2] & RelayBinary.FLAG_DEFLATE)) {
+                const body = new Blob([frame.subarray(RelayBinary.HEADER_SIZE)]);
+                const stream = body.stream().pipeThrough(new DecompressionStream('deflate-raw'));
+                return onText(await new Response(stream).text());
+            }
+            if (onBinary) {
+                return onBinary(data);
+            }
+        }).catch((e) => console.error('Relay message failed:', e));
+    }
+};
@@ -1,46 +1,56 @@
 #include "bmp_loader.h"
+#include "storage/sd_card.h"
+#include "utils/logger.h"
 
 bool BMPLoader::draw(TFT_eSPI& tft, const char* filename, int16_t x, int16_t y) {
+  // The SD bus is only held while reading, not while drawing, so the web
+  // server isn't kept waiting on the display
+  SDCard::lock();
   File bmpFile = SD.open(filename);
   if (!bmpFile) {
-    Serial.printf("Failed to open %s\n", filename);
+    SDCard::unlock();
+    LOG_WARN(LogModule::SYSTEM, "[Display] Failed to open %s", filename);
     return false;
   }
   
   // Read BMP header (simple 24-bit uncompressed BMP reader)
   if (bmpFile.read() != 'B' || bmpFile.read() != 'M') {
-    Serial.println("Not a BMP file");
+    LOG_WARN(LogModule::SYSTEM, "[Display] %s: not a BMP file", filename);
     bmpFile.close();
+    SDCard::unlock();
     return false;
   }
   
   bmpFile.seek(10);
-  uint32_t dataOffset = bmpFile.read() | (bmpFile.read() << 8) | 
+  uint32_t dataOffset = bmpFile.read() | (bmpFile.read() << 8) |
                        (bmpFile.read() << 16) | (bmpFile.read() << 24);
-  
+                       
   bmpFile.seek(18);
-  int32_t width = bmpFile.read() | (bmpFile.read() << 8) | 
+  int32_t width = bmpFile.read() | (bmpFile.read() << 8) |
                  (bmpFile.read() << 16) | (bmpFile.read() << 24);
-  int32_t height = bmpFile.read() | (bmpFile.read() << 8) | 
+  int32_t height = bmpFile.read() | (bmpFile.read() << 8) |
                   (bmpFile.read() << 16) | (bmpFile.read() << 24);
-  
+                  
   bmpFile.seek(28);
   uint16_t depth = bmpFile.read() | (bmpFile.read() << 8);
   
   if (depth != 24) {
-    Serial.printf("Unsupported bit depth: %d (need 24-bit BMP)\n", depth);
+    LOG_WARN(LogModule::SYSTEM, "[Display] %s: unsupported bit depth %d (need 24-bit BMP)", filename, depth);
     bmpFile.close();
+    SDCard::unlock();
     return false;
   }
+  SDCard::unlock();
   
   // BMPs are stored bottom-to-top
   uint32_t rowSize = ((width * 3 + 3) & ~3); // Row size padded to 4 bytes
   uint8_t row[rowSize];
   
-  bmpFile.seek(dataOffset);
   for (int row_idx = height - 1; row_idx >= 0; row_idx--) {
+    SDCard::lock();
     bmpFile.seek(dataOffset + row_idx * rowSize);
     bmpFile.read(row, rowSize);
+    SDCard::unlock();
     
     for (int col = 0; col < width; col++) {
       uint8_t b = row[col * 3];
@@ -51,11 +61,14 @@ bool BMPLoader::draw(TFT_eSPI& tft, const char* filename, int16_t x, int16_t y)
     }
   }
   
+  SDCard::lock();
   bmpFile.close();
+  SDCard::unlock();
   return true;
 }
 
 bool BMPLoader::validate(const char* filename) {
+  SDLock sd;
   File bmpFile = SD.open(filename);
   if (!bmpFile) {
     return false;
@@ -144,7 +144,8 @@ void DisplayManager::showConnectionScreen(const SystemConfig& config, const Stri
   tft.println(displayURL);
 }
 
-void DisplayManager::showStatsScreen(int wifiClients, int wsClients, bool sdMounted,
+void DisplayManager::showStatsScreen(int wifiClients, int wsClients, int queuedMessages,
+                                     uint32_t droppedMessages, bool sdMounted,
                                      const SystemConfig& config, const String& actualSSID) {
   // Clear screen
   tft.fillScreen(TFT_BLACK);
@@ -206,6 +207,14 @@ void DisplayManager::showStatsScreen(int wifiClients, int wsClients, bool sdMoun
   tft.print("WebSocket: ");
   tft.setTextColor(wsClients > 0 ? TFT_GREEN : TFT_YELLOW, TFT_BLACK);
   tft.println(wsClients);
+  y += 12;
+  
+  // Relay backpressure: messages waiting for slow clients / dropped so far
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setCursor(15, y);
+  tft.print("Queue: ");
+  tft.setTextColor(droppedMessages > 0 ? TFT_YELLOW : TFT_GREEN, TFT_BLACK);
+  tft.printf("%d (%lu dropped)", queuedMessages, (unsigned long)droppedMessages);
   y += 20;
   
   // Memory
@@ -22,7 +22,8 @@ public:
   static void showConnectionScreen(const SystemConfig& config, const String& actualSSID);
   
   // Show system stats screen
-  static void showStatsScreen(int wifiClients, int wsClients, bool sdMounted, 
+  static void showStatsScreen(int wifiClients, int wsClients, int queuedMessages,
+                              uint32_t droppedMessages, bool sdMounted,
                               const SystemConfig& config, const String& actualSSID);
   
   // Toggle between screens
@@ -4,20 +4,47 @@
 // Module includes
 #include "storage/sd_card.h"
 #include "storage/config.h"
+#include "storage/file_cache.h"
+#include "storage/file_index.h"
+#include "storage/game_catalog.h"
 #include "network/wifi_manager.h"
 #include "network/dns_server.h"
 #include "network/web_server.h"
 #include "network/websocket_server.h"
 #include "display/display.h"
 #include "utils/helpers.h"
+#include "utils/metrics.h"
+#include "utils/logger.h"
+#include "utils/spsc_queue.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 // Pin definitions for ESP32-2432S028
 #define SD_CS 5
 
+// WiFi and lwIP run on core 0, so the network services get core 1 to
+// themselves. Display, touch and card checks share core 0 at low priority:
+// a slow SPI redraw there can't delay a relayed message.
+static const BaseType_t NETWORK_CORE = 1;
+static const BaseType_t UI_CORE = 0;
+static const unsigned long STATUS_INTERVAL_MS = 500;
+
+// Relay numbers for the stats screen, published by the network task so the
+// UI task never reads relay state from the other core
+struct RelayStatus {
+  int wsClients;
+  uint32_t queuedMessages;
+  uint32_t messagesDropped;
+};
+
 // System state
 SystemConfig config;
 String actualSSID = "";
 bool sdCardMounted = false;
+SpscQueue<RelayStatus, 4> relayStatus;   // Network task -> UI task
+
+void networkTask(void* param);
+void uiTask(void* param);
 
 void setup() {
   // Initialize serial for debugging
@@ -25,13 +52,16 @@ void setup() {
   delay(1000);
   Serial.println("\n\n=== LAN Party Arcade ===");
   Serial.println("Modular Architecture V1.0\n");
-
+  
+  // Runtime logging goes through a ring buffer drained by its own task
+  Logger::begin();
+  
   // 1. Initialize display
   DisplayManager::init();
   
   // Show "SD Card: " on display
   // (Display module handles its own TFT operations internally)
-
+  
   // 2. Initialize SD card
   Serial.println("\nInitializing SD card...");
   sdCardMounted = SDCard::init(SD_CS);
@@ -42,7 +72,17 @@ void setup() {
   } else {
     Serial.println("Using default configuration");
   }
-
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++) {
+    Logger::setLevel((LogModule)i, config.logLevels[i]);
+  }
+  
+  // Index the card and set up the RAM cache for static files
+  FileIndex::init(config.httpFileIndex);
+  GameCatalog::scan();
+  if (config.httpCacheBytes >= 0) {
+    FileCache::init(config.httpCacheBytes, config.httpCacheMaxFile);
+  }
+  
   // 4. Start WiFi Access Point
   WiFiManager::startAccessPoint(config, actualSSID);
   
@@ -50,7 +90,7 @@ void setup() {
   DNSManager::start(53);
   
   // 6. Start Web Server
-  HTTPServer::start(80);
+  HTTPServer::start(config, 80);
   
   // 7. Start mDNS responder
   Serial.println("\n--- Starting mDNS ---");
@@ -63,7 +103,7 @@ void setup() {
   }
   
   // 8. Start WebSocket Server
-  WebSocketRelay::start(81);
+  WebSocketRelay::start(config, 81);
   
   // 9. Show connection screen
   DisplayManager::showConnectionScreen(config, actualSSID);
@@ -75,66 +115,138 @@ void setup() {
   Serial.printf("IP Address: %s\n", WiFiManager::getIP().toString().c_str());
   Serial.printf("Free RAM: %d KB\n", ESP.getFreeHeap() / 1024);
   Serial.println("All systems operational!");
+  
+  // 10. Hand over to the tasks: network above the UI, both above idle
+  xTaskCreatePinnedToCore(networkTask, "network", 8192, nullptr, 3, nullptr, NETWORK_CORE);
+  xTaskCreatePinnedToCore(uiTask, "ui", 6144, nullptr, 1, nullptr, UI_CORE);
 }
 
 void loop() {
-  // Process network services
-  DNSManager::process();
-  HTTPServer::process();
-  WebSocketRelay::process();
-  
-  // Handle touch input (simple detection - touch anywhere)
-  static unsigned long lastTouchTime = 0;
-  static bool wasTouched = false;
-  uint16_t touchX = 0, touchY = 0;
-  
-  bool isTouched = DisplayManager::checkTouch(touchX, touchY);
-  
-  // Detect touch press (rising edge)
-  if (isTouched && !wasTouched && (millis() - lastTouchTime > 500)) {
-    lastTouchTime = millis();
-    wasTouched = true;
+  // Everything runs in the tasks started by setup()
+  vTaskDelete(nullptr);
+}
+
+// DNS, HTTP and the WebSocket relay
+void networkTask(void* param) {
+  unsigned long lastStatus = 0;
+  unsigned long lastUpdate = 0;
+  RelayStats lastRelayStats = {};
+  
+  while (true) {
+    unsigned long passStarted = micros();
     
-    Serial.printf("=== SCREEN TAP DETECTED at (%d, %d) ===\n", touchX, touchY);
+    DNSManager::process();
+    HTTPServer::process();
+    WebSocketRelay::process();
     
-    DisplayManager::toggleScreen();
+    // Hand the display what it shows. If it hasn't taken the last ones yet
+    // this one is dropped; a newer one follows shortly. getStats() walks
+    // every outbox, so it's only called when something is reported.
+    if (millis() - lastStatus >= STATUS_INTERVAL_MS) {
+      lastStatus = millis();
+      const RelayStats& relayStats = WebSocketRelay::getStats();
+      RelayStatus status = { WebSocketRelay::getClientCount(), relayStats.queuedMessages,
+                             relayStats.messagesDropped };
+      relayStatus.push(status);
+    }
     
-    if (DisplayManager::getCurrentScreen() == Screen::CONNECTION) {
-      Serial.println("Showing: Connection Screen");
-      DisplayManager::showConnectionScreen(config, actualSSID);
-    } else {
-      Serial.println("Showing: Stats Screen");
+    // Show connected clients count (less frequent)
+    if (millis() - lastUpdate > 5000) { // Every 5 seconds
+      unsigned long elapsed = millis() - lastUpdate;
+      lastUpdate = millis();
+      const RelayStats& relayStats = WebSocketRelay::getStats();
+      
       int wifiClients = WiFiManager::getConnectedClients();
       int wsClients = WebSocketRelay::getClientCount();
-      DisplayManager::showStatsScreen(wifiClients, wsClients, sdCardMounted, config, actualSSID);
+      if (wifiClients > 0 || wsClients > 0) {
+        LOG_INFO(LogModule::SYSTEM, "WiFi clients: %d | WebSocket clients: %d", wifiClients, wsClients);
+        
+        // Relay throughput: with batching on, frames/s drops below msgs/s
+        LOG_INFO(LogModule::SYSTEM, "Relay: %lu msg/s in | %lu msg/s out | %lu frames/s | %lu KB/s out",
+                 (unsigned long)((relayStats.messagesIn - lastRelayStats.messagesIn) * 1000UL / elapsed),
+                 (unsigned long)((relayStats.messagesOut - lastRelayStats.messagesOut) * 1000UL / elapsed),
+                 (unsigned long)((relayStats.framesOut - lastRelayStats.framesOut) * 1000UL / elapsed),
+                 (unsigned long)((relayStats.bytesOut - lastRelayStats.bytesOut) / elapsed));
+                 
+        if (relayStats.messagesDropped != lastRelayStats.messagesDropped) {
+          LOG_WARN(LogModule::SYSTEM, "Relay backpressure: %lu queued | %lu dropped | %lu slow clients disconnected",
+                   (unsigned long)relayStats.queuedMessages,
+                   (unsigned long)relayStats.messagesDropped,
+                   (unsigned long)relayStats.slowClientsDropped);
+        }
+      }
+      lastRelayStats = relayStats;
     }
+    
+    Metrics::loopMicros.record(micros() - passStarted);
+    
+    // Downloads in flight: come straight back (one tick, so lower-priority
+    // tasks on this core still run) instead of capping them at a chunk per 10 ms
+    vTaskDelay(HTTPServer::isSending() ? 1 : pdMS_TO_TICKS(10));
   }
+}
+
+static void showStats(const RelayStatus& status) {
+  int wifiClients = WiFiManager::getConnectedClients();
+  DisplayManager::showStatsScreen(wifiClients, status.wsClients, status.queuedMessages,
+                                  status.messagesDropped, sdCardMounted, config, actualSSID);
+}
+
+// Display, touch and the SD card check
+void uiTask(void* param) {
+  RelayStatus status = {};
+  unsigned long lastTouchTime = 0;
+  bool wasTouched = false;
+  unsigned long lastStatsUpdate = 0;
   
-  // Track release
-  if (!isTouched) {
-    wasTouched = false;
-  }
-  
-  // Update stats screen if showing
-  static unsigned long lastStatsUpdate = 0;
-  if (DisplayManager::getCurrentScreen() == Screen::STATS && (millis() - lastStatsUpdate > 2000)) {
-    lastStatsUpdate = millis();
-    int wifiClients = WiFiManager::getConnectedClients();
-    int wsClients = WebSocketRelay::getClientCount();
-    DisplayManager::showStatsScreen(wifiClients, wsClients, sdCardMounted, config, actualSSID);
-  }
-  
-  // Show connected clients count (less frequent)
-  static unsigned long lastUpdate = 0;
-  if (millis() - lastUpdate > 5000) { // Every 5 seconds
-    lastUpdate = millis();
+  while (true) {
+    // Keep only the newest numbers from the network task
+    RelayStatus update;
+    while (relayStatus.pop(update)) {
+      status = update;
+    }
+    
+    // Pick up the SD card being pulled or swapped, and index and catalog
+    // the new one here rather than in the first request that notices
+    SDCard::poll();
+    sdCardMounted = SDCard::isMounted();
+    FileIndex::refresh();
+    GameCatalog::refresh();
+    
+    // Handle touch input (simple detection - touch anywhere)
+    uint16_t touchX = 0, touchY = 0;
+    bool isTouched = DisplayManager::checkTouch(touchX, touchY);
+    
+    // Detect touch press (rising edge)
+    if (isTouched && !wasTouched && (millis() - lastTouchTime > 500)) {
+      lastTouchTime = millis();
+      wasTouched = true;
+      
+      LOG_INFO(LogModule::SYSTEM, "=== SCREEN TAP DETECTED at (%d, %d) ===", touchX, touchY);
+      
+      DisplayManager::toggleScreen();
+      
+      if (DisplayManager::getCurrentScreen() == Screen::CONNECTION) {
+        LOG_INFO(LogModule::SYSTEM, "Showing: Connection Screen");
+        DisplayManager::showConnectionScreen(config, actualSSID);
+      } else {
+        LOG_INFO(LogModule::SYSTEM, "Showing: Stats Screen");
+        showStats(status);
+        lastStatsUpdate = millis();
+      }
+    }
     
-    int wifiClients = WiFiManager::getConnectedClients();
-    int wsClients = WebSocketRelay::getClientCount();
-    if (wifiClients > 0 || wsClients > 0) {
-      Serial.printf("WiFi clients: %d | WebSocket clients: %d\n", wifiClients, wsClients);
+    // Track release
+    if (!isTouched) {
+      wasTouched = false;
     }
+    
+    // Update stats screen if showing
+    if (DisplayManager::getCurrentScreen() == Screen::STATS && (millis() - lastStatsUpdate > 2000)) {
+      lastStatsUpdate = millis();
+      showStats(status);
+    }
+    
+    vTaskDelay(pdMS_TO_TICKS(20));
   }
-  
-  delay(10);
 }
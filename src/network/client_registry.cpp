@@ -0,0 +1,117 @@
+#include "client_registry.h"
+
+PlayerClient& ClientRegistry::connect(uint8_t clientNum) {
+  if (!indexReady) {
+    memset(index, NO_CLIENT, sizeof(index));
+    indexReady = true;
+  }
+  
+  // The library reuses slots; make sure a stale UUID can't linger
+  if (isConnected(clientNum)) {
+    disconnect(clientNum);
+  }
+  
+  PlayerClient& client = slots[clientNum];
+  client.uuid[0] = '\0';
+  client.lastSeen = millis();
+  client.room = 0;
+  connected |= (1UL << clientNum);
+  return client;
+}
+
+void ClientRegistry::disconnect(uint8_t clientNum) {
+  if (!isConnected(clientNum)) {
+    return;
+  }
+  
+  if (slots[clientNum].uuid[0] != '\0') {
+    removeFromIndex(clientNum);
+  }
+  slots[clientNum].uuid[0] = '\0';
+  connected &= ~(1UL << clientNum);
+}
+
+PlayerClient* ClientRegistry::get(uint8_t clientNum) {
+  return isConnected(clientNum) ? &slots[clientNum] : nullptr;
+}
+
+bool ClientRegistry::registerUuid(uint8_t clientNum, const char* uuid) {
+  size_t length = strlen(uuid);
+  if (!isConnected(clientNum) || length == 0 || length > UUID_MAX_LENGTH ||
+      slots[clientNum].uuid[0] != '\0') {
+    return false;
+  }
+  
+  memcpy(slots[clientNum].uuid, uuid, length + 1);
+  
+  // Same UUID on a new connection (page reload): the newest one gets the
+  // messages, the old slot keeps its UUID but drops out of the index
+  int existing = findBucket(uuid);
+  if (existing >= 0) {
+    index[existing] = clientNum;
+    return true;
+  }
+  
+  // Table is twice the slot count, so an empty bucket always exists
+  size_t bucket = hash(uuid) & (INDEX_SIZE - 1);
+  while (index[bucket] != NO_CLIENT) {
+    bucket = (bucket + 1) & (INDEX_SIZE - 1);
+  }
+  index[bucket] = clientNum;
+  return true;
+}
+
+uint8_t ClientRegistry::findUuid(const char* uuid) const {
+  int bucket = findBucket(uuid);
+  return bucket >= 0 ? index[bucket] : NO_CLIENT;
+}
+
+// FNV-1a: cheap, and plenty for a few dozen random UUIDs
+size_t ClientRegistry::hash(const char* uuid) {
+  uint32_t h = 2166136261UL;
+  while (*uuid) {
+    h ^= (uint8_t)*uuid++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+int ClientRegistry::findBucket(const char* uuid) const {
+  if (!indexReady) {
+    return -1;
+  }
+  
+  size_t bucket = hash(uuid) & (INDEX_SIZE - 1);
+  while (index[bucket] != NO_CLIENT) {
+    if (strcmp(slots[index[bucket]].uuid, uuid) == 0) {
+      return bucket;
+    }
+    bucket = (bucket + 1) & (INDEX_SIZE - 1);
+  }
+  return -1;
+}
+
+void ClientRegistry::removeFromIndex(uint8_t clientNum) {
+  int found = findBucket(slots[clientNum].uuid);
+  if (found < 0 || index[found] != clientNum) {
+    return;
+  }
+  
+  // Backward-shift deletion: pull later entries of the probe run into the
+  // hole, so lookups never need tombstones however long the party runs
+  size_t hole = found;
+  size_t bucket = (hole + 1) & (INDEX_SIZE - 1);
+  while (index[bucket] != NO_CLIENT) {
+    size_t home = hash(slots[index[bucket]].uuid) & (INDEX_SIZE - 1);
+    
+    // Move the entry if its home isn't cyclically within (hole, bucket]
+    bool movable = (bucket > hole) ? (home <= hole || home > bucket)
+                                   : (home <= hole && home > bucket);
+    if (movable) {
+      index[hole] = index[bucket];
+      hole = bucket;
+    }
+    bucket = (bucket + 1) & (INDEX_SIZE - 1);
+  }
+  index[hole] = NO_CLIENT;
+}
@@ -0,0 +1,63 @@
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+
+// Room membership and registry lookups use bitmasks indexed by clientNum
+static_assert(WEBSOCKETS_SERVER_CLIENT_MAX <= 32, "Client bitmasks hold at most 32 clients");
+
+// Placeholder clientNum for "nobody" (never assigned by the library)
+static const uint8_t NO_CLIENT = 0xFF;
+
+// UUIDs are generated client-side in the standard 8-4-4-4-12 form
+static const size_t UUID_MAX_LENGTH = 36;
+
+struct PlayerClient {
+  char uuid[UUID_MAX_LENGTH + 1];   // Empty until the client registers
+  unsigned long lastSeen;
+  uint8_t room;
+};
+
+// Fixed-size table of connected clients, indexed directly by the library's
+// clientNum, plus an open-addressed UUID -> clientNum hash for targeted sends.
+// Everything is inline, so connects and disconnects never touch the heap.
+class ClientRegistry {
+public:
+  // Claim the slot for a new connection (resets any previous contents)
+  PlayerClient& connect(uint8_t clientNum);
+  
+  // Free the slot and forget its UUID
+  void disconnect(uint8_t clientNum);
+  
+  // Connected client in this slot, or nullptr
+  PlayerClient* get(uint8_t clientNum);
+  
+  // Set a client's UUID (once); false if empty, too long or already set
+  bool registerUuid(uint8_t clientNum, const char* uuid);
+  
+  // clientNum registered with this UUID, or NO_CLIENT
+  uint8_t findUuid(const char* uuid) const;
+  
+  bool isConnected(uint8_t clientNum) const {
+    return clientNum < WEBSOCKETS_SERVER_CLIENT_MAX && (connected & (1UL << clientNum));
+  }
+  uint32_t getConnectedMask() const { return connected; }
+  int count() const { return __builtin_popcount(connected); }
+
+private:
+  // Power of two, at least twice the client limit so probes stay short
+  static const size_t INDEX_SIZE = WEBSOCKETS_SERVER_CLIENT_MAX <= 8 ? 16 :
+                                   WEBSOCKETS_SERVER_CLIENT_MAX <= 16 ? 32 : 64;
+                                   
+  PlayerClient slots[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint8_t index[INDEX_SIZE];    // clientNum per bucket, NO_CLIENT when empty
+  uint32_t connected = 0;
+  bool indexReady = false;
+  
+  static size_t hash(const char* uuid);
+  int findBucket(const char* uuid) const;
+  void removeFromIndex(uint8_t clientNum);
+};
+
+#endif
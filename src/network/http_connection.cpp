@@ -0,0 +1,321 @@
+#include "http_connection.h"
+#include "utils/metrics.h"
+#include "utils/logger.h"
+#include <lwip/sockets.h>
+
+// A request has this long to arrive once started; a kept-alive connection
+// with nothing to do is closed after the shorter idle time so it doesn't
+// hold a slot other phones are waiting for
+static const unsigned long REQUEST_TIMEOUT_MS = 5000;
+static const unsigned long KEEPALIVE_TIMEOUT_MS = 2000;
+
+// A client that takes nothing for this long is gone
+static const unsigned long SEND_TIMEOUT_MS = 10000;
+
+// Keep reading the card while the socket takes everything, up to this much
+// time per poll, so a fast client isn't held to one chunk per pass
+static const unsigned long PUMP_BUDGET_US = 2000;
+
+// Smaller transfers are mostly latency, not throughput
+static const size_t THROUGHPUT_MIN_BYTES = 16384;
+
+void HttpConnection::accept(WiFiClient& newClient) {
+  client = newClient;
+  client.setNoDelay(true);
+  state = HttpState::READING;
+  received = 0;
+  keptAlive = false;
+  clearHeaders();
+  lastActivity = millis();
+}
+
+// Only a connection that has already had an answer counts: a fresh one may
+// have its first request sitting unread in the socket
+bool HttpConnection::isIdle() {
+  return state == HttpState::READING && received == 0 && keptAlive && client.available() == 0;
+}
+
+void HttpConnection::close() {
+  fileBytes = 0;
+  FileCache::release(cached);
+  cached = nullptr;
+  if (file) {
+    file.close();
+  }
+  content = String();
+  client.stop();
+  state = HttpState::FREE;
+}
+
+bool HttpConnection::poll() {
+  switch (state) {
+    case HttpState::READING:
+      return readRequest();
+      
+    case HttpState::SENDING:
+      pump();
+      return false;
+      
+    default:
+      return false;
+  }
+}
+
+bool HttpConnection::readRequest() {
+  int available = client.available();
+  if (available <= 0) {
+    unsigned long timeout = received == 0 ? KEEPALIVE_TIMEOUT_MS : REQUEST_TIMEOUT_MS;
+    if (!client.connected() || millis() - lastActivity > timeout) {
+      close();
+    }
+    return false;
+  }
+  
+  // Leave room for a terminator so the buffer can be searched as a string
+  size_t room = HTTP_BUFFER_SIZE - 1 - received;
+  if (room == 0) {
+    sendError(431);
+    return false;
+  }
+  
+  if (received == 0) {
+    requestStarted = micros();
+  }
+  int n = client.read(buffer + received, (size_t)available < room ? (size_t)available : room);
+  if (n <= 0) {
+    return false;
+  }
+  received += n;
+  lastActivity = millis();
+  buffer[received] = '\0';
+  
+  char* end = strstr((char*)buffer, "\r\n\r\n");
+  if (end == nullptr) {
+    if (received == HTTP_BUFFER_SIZE - 1) {
+      sendError(431);
+    }
+    return false;
+  }
+  
+  size_t length = end + 4 - (char*)buffer;
+  buffer[length] = '\0';
+  int error = request.parse((char*)buffer);
+  
+  // Request bodies and pipelined requests aren't supported: answer this
+  // one and close rather than misread what follows
+  if (length < received) {
+    request.keepAlive = false;
+  }
+  
+  if (error != 0) {
+    sendError(error);
+    return false;
+  }
+  
+  state = HttpState::READY;
+  return true;
+}
+
+void HttpConnection::addHeader(const char* name, const char* value) {
+  int n = snprintf(headers + headersLength, sizeof(headers) - headersLength,
+                   "%s: %s\r\n", name, value);
+  if (n < 0 || headersLength + n >= sizeof(headers)) {
+    LOG_WARN(LogModule::HTTP, "[HTTP] Header dropped (no room): %s", name);
+    headers[headersLength] = '\0';
+    return;
+  }
+  headersLength += n;
+}
+
+void HttpConnection::clearHeaders() {
+  headersLength = 0;
+  headers[0] = '\0';
+}
+
+const char* HttpConnection::statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 206: return "Partial Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 414: return "URI Too Long";
+    case 416: return "Range Not Satisfiable";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+// Status line and headers go into buffer; the body follows from bodyData
+// or the file
+void HttpConnection::writeHead(int code, const char* contentType, size_t length) {
+  int n = snprintf((char*)buffer, HTTP_BUFFER_SIZE, "HTTP/1.1 %d %s\r\n", code, statusText(code));
+  if (contentType != nullptr) {
+    n += snprintf((char*)buffer + n, HTTP_BUFFER_SIZE - n, "Content-Type: %s\r\n", contentType);
+  }
+  
+  // A 304 has no body, and its length would describe the full response
+  if (code != 304) {
+    n += snprintf((char*)buffer + n, HTTP_BUFFER_SIZE - n, "Content-Length: %u\r\n", (unsigned)length);
+  }
+  n += snprintf((char*)buffer + n, HTTP_BUFFER_SIZE - n, "Connection: %s\r\n%s\r\n",
+                request.keepAlive ? "keep-alive" : "close", headers);
+                
+  pending = buffer;
+  pendingLength = n;
+  bodyRemaining = request.head || code == 304 ? 0 : length;
+  state = HttpState::SENDING;
+  lastActivity = millis();
+}
+
+void HttpConnection::send(int code, const char* contentType, const String& body) {
+  content = body;
+  writeHead(code, contentType, content.length());
+  bodyData = (const uint8_t*)content.c_str();
+  pump();
+}
+
+void HttpConnection::sendCached(int code, const char* contentType, const CachedFile* file,
+                                size_t offset, size_t length) {
+  cached = file;
+  writeHead(code, contentType, length);
+  bodyData = file->data + offset;
+  pump();
+}
+
+void HttpConnection::sendFile(int code, const char* contentType, File& source,
+                              size_t offset, size_t length) {
+  file = source;
+  source = File();
+  if (offset > 0) {
+    file.seek(offset);
+  }
+  fileOffset = offset;
+  writeHead(code, contentType, length);
+  bodyData = nullptr;
+  fileBytes = bodyRemaining;
+  fileStarted = micros();
+  
+  // First chunk rides in the same segment as the headers
+  fillFromFile();
+  pump();
+}
+
+// Read the next chunk of the file in behind whatever's pending in buffer
+bool HttpConnection::fillFromFile() {
+  size_t offset = pendingLength > 0 ? (pending - buffer) + pendingLength : 0;
+  if (bodyRemaining == 0 || offset >= HTTP_BUFFER_SIZE) {
+    return false;
+  }
+  
+  size_t room = HTTP_BUFFER_SIZE - offset;
+  size_t want = bodyRemaining < room ? bodyRemaining : room;
+  
+  // End each read on a sector boundary of the file, so after the first one
+  // (which shares the buffer with the headers) every read is whole sectors
+  if (want < bodyRemaining) {
+    size_t end = (fileOffset + want) & ~(SD_SECTOR_SIZE - 1);
+    if (end > fileOffset) {
+      want = end - fileOffset;
+    }
+  }
+  
+  int n = file.read(buffer + offset, want);
+  if (n <= 0) {
+    // Card pulled mid-transfer: the length is already promised, so all we
+    // can do is drop the connection
+    LOG_ERROR(LogModule::HTTP, "[HTTP] SD read failed mid-response");
+    bodyRemaining = 0;
+    request.keepAlive = false;
+    return false;
+  }
+  
+  if (pendingLength == 0) {
+    pending = buffer;
+  }
+  pendingLength += n;
+  bodyRemaining -= n;
+  fileOffset += n;
+  return true;
+}
+
+// Send as much as the socket takes without waiting, reading further chunks
+// from the SD card only while the socket keeps up and the budget lasts
+void HttpConnection::pump() {
+  unsigned long started = micros();
+  
+  while (true) {
+    if (pendingLength == 0) {
+      if (bodyRemaining == 0) {
+        finish();
+        return;
+      }
+      if (bodyData != nullptr) {
+        pending = bodyData;
+        pendingLength = bodyRemaining;
+        bodyRemaining = 0;
+      } else if (micros() - started >= PUMP_BUDGET_US || !fillFromFile()) {
+        break;
+      }
+    }
+    
+    ssize_t sent = ::send(client.fd(), pending, pendingLength, MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close();
+        return;
+      }
+      break;
+    }
+    pending += sent;
+    pendingLength -= sent;
+    lastActivity = millis();
+    if (sent == 0) {
+      break;
+    }
+  }
+  
+  if (millis() - lastActivity > SEND_TIMEOUT_MS) {
+    LOG_INFO(LogModule::HTTP, "[HTTP] Client stopped reading - closing");
+    close();
+  }
+}
+
+void HttpConnection::finish() {
+  unsigned long now = micros();
+  Metrics::httpMicros.record(now - requestStarted);
+  if (fileBytes >= THROUGHPUT_MIN_BYTES && now != fileStarted) {
+    Metrics::fileKBps.record((uint64_t)fileBytes * 1000000 / 1024 / (now - fileStarted));
+  }
+  fileBytes = 0;
+  
+  FileCache::release(cached);
+  cached = nullptr;
+  if (file) {
+    file.close();
+  }
+  content = String();
+  bodyData = nullptr;
+  pending = nullptr;
+  
+  if (!request.keepAlive) {
+    close();
+    return;
+  }
+  state = HttpState::READING;
+  received = 0;
+  keptAlive = true;
+  clearHeaders();
+  lastActivity = millis();
+}
+
+void HttpConnection::sendError(int code) {
+  char page[96];
+  snprintf(page, sizeof(page), "<html><body><h1>%d %s</h1></body></html>", code, statusText(code));
+  request.keepAlive = false;
+  request.head = false;
+  send(code, "text/html", page);
+}
@@ -0,0 +1,91 @@
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <FS.h>
+#include "http_request.h"
+#include "storage/file_cache.h"
+
+// Requests are read into it and file chunks out of the SD card into it.
+// Eight whole sectors, so file reads go straight to the card in one
+// multi-sector transfer instead of through the FAT layer's sector cache.
+static const size_t HTTP_BUFFER_SIZE = 4096;
+static const size_t SD_SECTOR_SIZE = 512;
+static const size_t HTTP_HEADERS_MAX_LENGTH = 383;   // Extra response headers
+
+enum class HttpState : uint8_t {
+  FREE,       // Slot not in use
+  READING,    // Waiting for (the rest of) a request
+  READY,      // Request parsed, waiting for a handler to respond
+  SENDING     // Response going out a slice at a time
+};
+
+// One keep-alive browser connection. Nothing here blocks: each poll() reads
+// what has arrived, or sends what the socket will take right now, reading
+// more from the SD card for up to ~2 ms, so a 200 KB image can't stall the relay.
+class HttpConnection {
+public:
+  void accept(WiFiClient& newClient);
+  
+  // Advance reading/sending. True when a request is ready to be answered
+  // with one of the send calls below.
+  bool poll();
+  
+  HttpState getState() const { return state; }
+  const HttpRequest& getRequest() const { return request; }
+  
+  // Kept alive after a response with nothing in flight, so it can be
+  // closed to make room
+  bool isIdle();
+  void close();
+  
+  // Extra header for the response about to be sent
+  void addHeader(const char* name, const char* value);
+  void clearHeaders();
+  
+  // Exactly one of these per request. The file ones send `length` bytes
+  // from `offset`; sendCached releases the file once it's sent, sendFile
+  // takes the file over and closes it.
+  void send(int code, const char* contentType, const String& body);
+  void sendCached(int code, const char* contentType, const CachedFile* file,
+                  size_t offset, size_t length);
+  void sendFile(int code, const char* contentType, File& file, size_t offset, size_t length);
+
+private:
+  WiFiClient client;
+  HttpState state = HttpState::FREE;
+  HttpRequest request;
+  unsigned long lastActivity = 0;     // millis() of the last byte in or out
+  unsigned long requestStarted = 0;   // micros() when the request started arriving
+  bool keptAlive = false;             // At least one response finished on this connection
+  
+  alignas(4) uint8_t buffer[HTTP_BUFFER_SIZE];
+  size_t received = 0;                // Request bytes in buffer (READING)
+  
+  char headers[HTTP_HEADERS_MAX_LENGTH + 1];
+  size_t headersLength = 0;
+  
+  // What's left to send: pending bytes first, then the rest of the body
+  const uint8_t* pending = nullptr;
+  size_t pendingLength = 0;
+  const uint8_t* bodyData = nullptr;  // In-memory body, or nullptr to read from file
+  size_t bodyRemaining = 0;
+  String content;                     // Owns the body of send()
+  const CachedFile* cached = nullptr;
+  File file;
+  size_t fileOffset = 0;              // Where the next read starts
+  size_t fileBytes = 0;               // Body bytes coming from the card, for throughput
+  unsigned long fileStarted = 0;      // micros() when the file response began
+  
+  bool readRequest();
+  void writeHead(int code, const char* contentType, size_t length);
+  bool fillFromFile();
+  void pump();
+  void finish();
+  void sendError(int code);
+  
+  static const char* statusText(int code);
+};
+
+#endif
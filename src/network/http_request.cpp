@@ -0,0 +1,184 @@
+#include "http_request.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Cuts the block up in place. Returns 0, or the status code to answer with.
+int HttpRequest::parse(char* block) {
+  *this = HttpRequest();
+  
+  // Request line: METHOD SP target SP version
+  char* line = block;
+  char* lineEnd = strstr(line, "\r\n");
+  if (lineEnd == nullptr) {
+    return 400;
+  }
+  *lineEnd = '\0';
+  
+  char* target = strchr(line, ' ');
+  if (target == nullptr) {
+    return 400;
+  }
+  *target++ = '\0';
+  char* version = strchr(target, ' ');
+  if (version == nullptr || target[0] != '/') {
+    return 400;
+  }
+  *version++ = '\0';
+  keepAlive = strcmp(version, "HTTP/1.0") != 0;
+  
+  // Headers
+  char* next = lineEnd + 2;
+  while (*next != '\0' && *next != '\r') {
+    char* end = strstr(next, "\r\n");
+    if (end == nullptr) {
+      return 400;
+    }
+    *end = '\0';
+    char* colon = strchr(next, ':');
+    if (colon != nullptr) {
+      *colon = '\0';
+      char* value = colon + 1;
+      while (*value == ' ' || *value == '\t') {
+        value++;
+      }
+      parseHeader(next, value);
+    }
+    next = end + 2;
+  }
+  
+  head = strcmp(line, "HEAD") == 0;
+  if (!head && strcmp(line, "GET") != 0) {
+    keepAlive = false;
+    return 405;
+  }
+  
+  char* params = strchr(target, '?');
+  if (params != nullptr) {
+    *params++ = '\0';
+    if (strlen(params) > HTTP_QUERY_MAX_LENGTH) {
+      return 414;
+    }
+    strcpy(query, params);
+  }
+  
+  // Percent-decode the path
+  size_t n = 0;
+  for (const char* c = target; *c != '\0'; c++) {
+    if (n >= HTTP_PATH_MAX_LENGTH) {
+      return 414;
+    }
+    char decoded = *c;
+    if (*c == '%' && isxdigit((unsigned char)c[1]) && isxdigit((unsigned char)c[2])) {
+      char hex[3] = { c[1], c[2], '\0' };
+      decoded = (char)strtol(hex, nullptr, 16);
+      c += 2;
+    }
+    if (decoded == '\0') {
+      return 400;
+    }
+    path[n++] = decoded;
+  }
+  path[n] = '\0';
+  return 0;
+}
+
+void HttpRequest::parseHeader(const char* name, const char* value) {
+  if (strcasecmp(name, "Connection") == 0) {
+    // "close" or "keep-alive", in any case
+    char token[12];
+    size_t n = 0;
+    for (; value[n] != '\0' && n < sizeof(token) - 1; n++) {
+      token[n] = tolower((unsigned char)value[n]);
+    }
+    token[n] = '\0';
+    if (strstr(token, "close") != nullptr) {
+      keepAlive = false;
+    } else if (strstr(token, "keep-alive") != nullptr) {
+      keepAlive = true;
+    }
+  } else if (strcasecmp(name, "Accept-Encoding") == 0) {
+    acceptsGzip = strstr(value, "gzip") != nullptr;
+  } else if (strcasecmp(name, "If-None-Match") == 0) {
+    strncpy(ifNoneMatch, value, sizeof(ifNoneMatch) - 1);
+  } else if (strcasecmp(name, "If-Modified-Since") == 0) {
+    strncpy(ifModifiedSince, value, sizeof(ifModifiedSince) - 1);
+  } else if (strcasecmp(name, "Range") == 0) {
+    strncpy(range, value, sizeof(range) - 1);
+  } else if (strcasecmp(name, "If-Range") == 0) {
+    strncpy(ifRange, value, sizeof(ifRange) - 1);
+  }
+}
+
+bool HttpRequest::getParam(const char* name, char* out, size_t outSize) const {
+  size_t nameLength = strlen(name);
+  const char* param = query;
+  while (param != nullptr && *param != '\0') {
+    if (strncmp(param, name, nameLength) == 0 && param[nameLength] == '=') {
+      const char* value = param + nameLength + 1;
+      size_t n = 0;
+      while (value[n] != '\0' && value[n] != '&' && n + 1 < outSize) {
+        out[n] = value[n];
+        n++;
+      }
+      out[n] = '\0';
+      return true;
+    }
+    param = strchr(param, '&');
+    if (param != nullptr) {
+      param++;
+    }
+  }
+  return false;
+}
+
+// One "bytes=" range: first-last, first- or -suffix. Anything else (several
+// ranges, other units) is ignored and the whole file sent, as RFC 9110 allows.
+RangeResult HttpRequest::parseRange(const char* header, size_t size, size_t& offset, size_t& length) {
+  if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',') != nullptr) {
+    return RangeResult::IGNORED;
+  }
+  
+  const char* spec = header + 6;
+  const char* dash = strchr(spec, '-');
+  if (dash == nullptr) {
+    return RangeResult::IGNORED;
+  }
+  
+  char* end;
+  if (dash == spec) {
+    // Last N bytes
+    unsigned long suffix = strtoul(dash + 1, &end, 10);
+    if (end == dash + 1 || *end != '\0') {
+      return RangeResult::IGNORED;
+    }
+    if (suffix == 0 || size == 0) {
+      return RangeResult::UNSATISFIABLE;
+    }
+    length = suffix < size ? suffix : size;
+    offset = size - length;
+    return RangeResult::PARTIAL;
+  }
+  
+  unsigned long first = strtoul(spec, &end, 10);
+  if (end != dash) {
+    return RangeResult::IGNORED;
+  }
+  unsigned long last = size > 0 ? size - 1 : 0;
+  if (dash[1] != '\0') {
+    last = strtoul(dash + 1, &end, 10);
+    if (*end != '\0' || last < first) {
+      return RangeResult::IGNORED;
+    }
+  }
+  if (first >= size) {
+    return RangeResult::UNSATISFIABLE;
+  }
+  if (last >= size) {
+    last = size - 1;
+  }
+  offset = first;
+  length = last - first + 1;
+  return RangeResult::PARTIAL;
+}
@@ -0,0 +1,41 @@
+#ifndef HTTP_REQUEST_H
+#define HTTP_REQUEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t HTTP_PATH_MAX_LENGTH = 127;
+static const size_t HTTP_QUERY_MAX_LENGTH = 63;
+
+// What a Range header asks of a body: all of it (header missing or not one
+// we handle), one part of it, or nothing it has
+enum class RangeResult : uint8_t { IGNORED, PARTIAL, UNSATISFIABLE };
+
+// The parts of a request the handlers look at
+struct HttpRequest {
+  bool head;                                // HEAD: send headers only
+  bool keepAlive;
+  bool acceptsGzip;
+  char path[HTTP_PATH_MAX_LENGTH + 1];      // Percent-decoded, without the query
+  char query[HTTP_QUERY_MAX_LENGTH + 1];
+  char ifNoneMatch[64];
+  char ifModifiedSince[32];
+  char range[32];                           // "bytes=0-1023"
+  char ifRange[40];                         // Only honour range if this still matches
+  
+  // Fill in from a header block (request line through the blank line,
+  // NUL-terminated), which is cut up in place. Returns 0, or the status
+  // code to answer with.
+  int parse(char* block);
+  
+  // Value of a query parameter (not decoded); false if it isn't there
+  bool getParam(const char* name, char* out, size_t outSize) const;
+  
+  // The part of a `size`-byte body a Range header asks for
+  static RangeResult parseRange(const char* header, size_t size, size_t& offset, size_t& length);
+
+private:
+  void parseHeader(const char* name, const char* value);
+};
+
+#endif
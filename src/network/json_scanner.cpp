@@ -0,0 +1,174 @@
+#include "json_scanner.h"
+#include <string.h>
+
+bool JsonSpan::equals(const char* text) const {
+  size_t textLength = strlen(text);
+  return isString() && length == textLength + 2 && memcmp(data + 1, text, textLength) == 0;
+}
+
+bool JsonSpan::startsWith(const char* prefix) const {
+  size_t prefixLength = strlen(prefix);
+  return isString() && length >= prefixLength + 2 && memcmp(data + 1, prefix, prefixLength) == 0;
+}
+
+size_t JsonScanner::skipWhitespace(const uint8_t* data, size_t length, size_t i) {
+  while (i < length && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')) {
+    i++;
+  }
+  return i;
+}
+
+// i points at the opening quote; returns the index just past the closing quote
+// (or length if the string is unterminated)
+size_t JsonScanner::skipString(const uint8_t* data, size_t length, size_t i) {
+  i++;
+  while (i < length) {
+    if (data[i] == '\\') {
+      i += 2;
+    } else if (data[i] == '"') {
+      return i + 1;
+    } else {
+      i++;
+    }
+  }
+  return length;
+}
+
+// Skip one value of any type. Nested objects/arrays are skipped with a depth
+// counter rather than recursion so a hostile payload can't blow the stack.
+size_t JsonScanner::skipValue(const uint8_t* data, size_t length, size_t i) {
+  if (i >= length) return length;
+  
+  if (data[i] == '"') {
+    return skipString(data, length, i);
+  }
+  
+  if (data[i] == '{' || data[i] == '[') {
+    size_t depth = 0;
+    while (i < length) {
+      uint8_t c = data[i];
+      if (c == '"') {
+        i = skipString(data, length, i);
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+        if (depth == 0) return i + 1;
+      }
+      i++;
+    }
+    return length;
+  }
+  
+  // Number, true, false or null
+  while (i < length && data[i] != ',' && data[i] != '}' && data[i] != ']' &&
+         data[i] != ' ' && data[i] != '\t' && data[i] != '\n' && data[i] != '\r') {
+    i++;
+  }
+  return i;
+}
+
+bool JsonScanner::scanObject(const uint8_t* payload, size_t length,
+                             const char* const* keys, JsonSpan* values, size_t keyCount) {
+  for (size_t k = 0; k < keyCount; k++) {
+    values[k] = JsonSpan();
+  }
+  
+  size_t i = skipWhitespace(payload, length, 0);
+  if (i >= length || payload[i] != '{') return false;
+  i++;
+  
+  size_t found = 0;
+  while (true) {
+    i = skipWhitespace(payload, length, i);
+    if (i >= length) return false;
+    if (payload[i] == '}') return true;
+    if (payload[i] != '"') return false;
+    
+    // Key
+    size_t keyStart = i + 1;
+    i = skipString(payload, length, i);
+    if (i >= length) return false;
+    size_t keyLength = i - 1 - keyStart;
+    
+    i = skipWhitespace(payload, length, i);
+    if (i >= length || payload[i] != ':') return false;
+    i = skipWhitespace(payload, length, i + 1);
+    
+    // Value
+    size_t valueStart = i;
+    i = skipValue(payload, length, i);
+    if (i == valueStart) return false;
+    
+    for (size_t k = 0; k < keyCount; k++) {
+      if (!values[k].isPresent() && strlen(keys[k]) == keyLength &&
+          memcmp(payload + keyStart, keys[k], keyLength) == 0) {
+        values[k].data = payload + valueStart;
+        values[k].length = i - valueStart;
+        found++;
+        break;
+      }
+    }
+    
+    // Stop as soon as everything we asked for has been seen
+    if (found == keyCount) return true;
+    
+    i = skipWhitespace(payload, length, i);
+    if (i >= length) return false;
+    if (payload[i] == ',') {
+      i++;
+    } else if (payload[i] != '}') {
+      return false;
+    }
+  }
+}
+
+bool JsonScanner::copyString(const JsonSpan& span, char* out, size_t outSize) {
+  if (!span.isString() || span.data[span.length - 1] != '"') return false;
+  
+  size_t contentLength = span.length - 2;
+  if (contentLength + 1 > outSize) return false;
+  
+  const uint8_t* content = span.data + 1;
+  if (memchr(content, '\\', contentLength) != nullptr) return false;
+  
+  memcpy(out, content, contentLength);
+  out[contentLength] = '\0';
+  return true;
+}
+
+bool JsonScanner::findString(const uint8_t* payload, size_t length, const char* key,
+                             char* out, size_t outSize) {
+  JsonSpan value;
+  if (!scanObject(payload, length, &key, &value, 1)) return false;
+  return copyString(value, out, outSize);
+}
+
+bool JsonScanner::nextElement(const JsonSpan& array, size_t& cursor, JsonSpan& element) {
+  if (!array.isPresent() || array.length < 2 || array.data[0] != '[') {
+    return false;
+  }
+  
+  // Stay inside the brackets
+  const uint8_t* data = array.data;
+  size_t length = array.length - 1;
+  size_t i = skipWhitespace(data, length, cursor == 0 ? 1 : cursor);
+  if (i < length && data[i] == ',') {
+    i = skipWhitespace(data, length, i + 1);
+  }
+  if (i >= length) {
+    return false;
+  }
+  
+  size_t end = skipValue(data, length, i);
+  if (end == i) {
+    return false;
+  }
+  
+  element.data = data + i;
+  element.length = end - i;
+  cursor = end;
+  return true;
+}
@@ -0,0 +1,46 @@
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw value token inside a JSON payload (points into the payload, no copy)
+struct JsonSpan {
+  const uint8_t* data = nullptr;
+  size_t length = 0;
+  
+  bool isPresent() const { return data != nullptr; }
+  bool isString() const { return length >= 2 && data[0] == '"'; }
+  
+  // Compare the contents of a string value (without quotes)
+  bool equals(const char* text) const;
+  bool startsWith(const char* prefix) const;
+};
+
+class JsonScanner {
+public:
+  // Walk the top-level keys of a JSON object once and record the raw value
+  // span of each requested key. Never allocates and never reads past length.
+  // Returns false if the payload is not a well-formed top-level object.
+  static bool scanObject(const uint8_t* payload, size_t length,
+                         const char* const* keys, JsonSpan* values, size_t keyCount);
+                         
+  // Find a top-level string value and copy it (without quotes) into out.
+  // Fails if the key is missing, not a string, escaped, or doesn't fit.
+  static bool findString(const uint8_t* payload, size_t length, const char* key,
+                         char* out, size_t outSize);
+                         
+  // Copy a string span (without quotes) into out, same rules as findString
+  static bool copyString(const JsonSpan& span, char* out, size_t outSize);
+  
+  // Step through the elements of an array span. Start with cursor = 0;
+  // returns false once there are no more elements.
+  static bool nextElement(const JsonSpan& array, size_t& cursor, JsonSpan& element);
+
+private:
+  static size_t skipWhitespace(const uint8_t* data, size_t length, size_t i);
+  static size_t skipString(const uint8_t* data, size_t length, size_t i);
+  static size_t skipValue(const uint8_t* data, size_t length, size_t i);
+};
+
+#endif
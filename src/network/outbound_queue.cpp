@@ -0,0 +1,75 @@
+#include "outbound_queue.h"
+
+// Each record is a 16-bit little-endian length followed by the message bytes
+static const size_t RECORD_HEADER_SIZE = 2;
+
+bool OutboundQueue::init(size_t size) {
+  buffer = (uint8_t*)malloc(size);
+  capacity = buffer ? size : 0;
+  clear();
+  return buffer != nullptr;
+}
+
+bool OutboundQueue::push(const uint8_t* data, size_t length) {
+  size_t needed = length + RECORD_HEADER_SIZE;
+  if (buffer == nullptr || length > 0xFFFF || bytes() + needed > capacity) {
+    return false;
+  }
+  
+  if (tail + needed > capacity) {
+    compact();
+  }
+  
+  buffer[tail] = length & 0xFF;
+  buffer[tail + 1] = (length >> 8) & 0xFF;
+  memcpy(buffer + tail + RECORD_HEADER_SIZE, data, length);
+  tail += needed;
+  messageCount++;
+  return true;
+}
+
+bool OutboundQueue::canHold(size_t length) const {
+  return length <= 0xFFFF && length + RECORD_HEADER_SIZE <= capacity;
+}
+
+bool OutboundQueue::front(const uint8_t*& data, size_t& length) const {
+  if (messageCount == 0) {
+    return false;
+  }
+  
+  length = buffer[head] | (buffer[head + 1] << 8);
+  data = buffer + head + RECORD_HEADER_SIZE;
+  return true;
+}
+
+void OutboundQueue::pop() {
+  if (messageCount == 0) {
+    return;
+  }
+  
+  size_t length = buffer[head] | (buffer[head + 1] << 8);
+  head += length + RECORD_HEADER_SIZE;
+  messageCount--;
+  
+  if (messageCount == 0) {
+    head = 0;
+    tail = 0;
+  }
+}
+
+void OutboundQueue::clear() {
+  head = 0;
+  tail = 0;
+  messageCount = 0;
+}
+
+// Slide the live records back to the start of the buffer
+void OutboundQueue::compact() {
+  if (head == 0) {
+    return;
+  }
+  
+  memmove(buffer, buffer + head, tail - head);
+  tail -= head;
+  head = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <Arduino.h>
+
+// Fixed-size FIFO of length-prefixed messages for one client.
+// The buffer is allocated once and reused, so queueing never touches the heap.
+class OutboundQueue {
+public:
+  // Allocate the backing buffer (call once at startup)
+  bool init(size_t capacity);
+  
+  // Append a copy of a message; false if it doesn't fit
+  bool push(const uint8_t* data, size_t length);
+  
+  // Would this message fit in an empty queue?
+  bool canHold(size_t length) const;
+  
+  // Peek at the oldest message; false if empty
+  bool front(const uint8_t*& data, size_t& length) const;
+  
+  // Remove the oldest message
+  void pop();
+  
+  // Drop everything
+  void clear();
+  
+  bool isEmpty() const { return messageCount == 0; }
+  size_t count() const { return messageCount; }
+  size_t bytes() const { return tail - head; }
+  size_t getCapacity() const { return capacity; }
+
+private:
+  uint8_t* buffer = nullptr;
+  size_t capacity = 0;
+  size_t head = 0;
+  size_t tail = 0;
+  size_t messageCount = 0;
+  
+  void compact();
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "session_table.h"
+
+bool SessionTable::park(const char* uuid, uint8_t room, uint8_t clientNum, unsigned long expiresAt) {
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    ParkedSession& session = sessions[i];
+    if (session.uuid[0] == '\0') {
+      strncpy(session.uuid, uuid, UUID_MAX_LENGTH);
+      session.uuid[UUID_MAX_LENGTH] = '\0';
+      session.room = room;
+      session.clientNum = clientNum;
+      session.expiresAt = expiresAt;
+      parkedCount++;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SessionTable::reclaim(const char* uuid, ParkedSession& session) {
+  if (parkedCount == 0) {
+    return false;
+  }
+  
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    if (sessions[i].uuid[0] != '\0' && strcmp(sessions[i].uuid, uuid) == 0) {
+      return take(i, session);
+    }
+  }
+  return false;
+}
+
+bool SessionTable::expire(unsigned long now, ParkedSession& session) {
+  if (parkedCount == 0) {
+    return false;
+  }
+  
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    if (sessions[i].uuid[0] != '\0' && (long)(now - sessions[i].expiresAt) >= 0) {
+      return take(i, session);
+    }
+  }
+  return false;
+}
+
+bool SessionTable::take(uint8_t index, ParkedSession& session) {
+  session = sessions[index];
+  sessions[index].uuid[0] = '\0';
+  parkedCount--;
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include "client_registry.h"
+
+// A player who dropped and may still come back
+struct ParkedSession {
+  char uuid[UUID_MAX_LENGTH + 1];   // Empty = free entry
+  uint8_t room;
+  uint8_t clientNum;                // Slot the player had before dropping
+  unsigned long expiresAt;          // millis()
+};
+
+// Sessions of disconnected players, held for the reconnect grace period so a
+// returning UUID gets its room back without anyone seeing it leave. Fixed
+// size (one entry per client slot), no heap use.
+class SessionTable {
+public:
+  // Hold a session until expiresAt; false if the table is full
+  bool park(const char* uuid, uint8_t room, uint8_t clientNum, unsigned long expiresAt);
+  
+  // Take back a held session by UUID; false if there is none
+  bool reclaim(const char* uuid, ParkedSession& session);
+  
+  // Remove one session whose grace period has run out; false if none
+  bool expire(unsigned long now, ParkedSession& session);
+  
+  uint8_t count() const { return parkedCount; }
+
+private:
+  ParkedSession sessions[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint8_t parkedCount = 0;
+  
+  bool take(uint8_t index, ParkedSession& session);
+};
+
+#endif
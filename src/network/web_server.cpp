@@ -1,32 +1,134 @@
 #include "web_server.h"
+#include "websocket_server.h"
+#include "utils/metrics.h"
+#include "utils/logger.h"
+#include "storage/file_cache.h"
+#include "storage/file_index.h"
+#include "storage/game_catalog.h"
+#include "storage/cartridge.h"
 #include <SD.h>
+#include <ArduinoJson.h>
 
-WebServer HTTPServer::server(80);
+WiFiServer HTTPServer::listener(80);
+HttpConnection HTTPServer::connections[HTTPServer::MAX_CONNECTIONS];
+String HTTPServer::defaultCacheControl = "no-cache";
 
-void HTTPServer::setupRoutes() {
+void HTTPServer::route(HttpConnection& connection) {
+  const HttpRequest& request = connection.getRequest();
+  
   // Captive portal detection endpoints - redirect to test page
   // (Currently commented out as per user preference)
   /*
-  server.on("/generate_204", []() { // Android
-    server.sendHeader("Location", "http://play.local/test.html", true);
-    server.send(302, "text/plain", "");
-  });
-  
-  server.on("/hotspot-detect.html", []() { // iOS/macOS
-    server.sendHeader("Location", "http://play.local/test.html", true);
-    server.send(302, "text/plain", "");
-  });
-  
-  server.on("/connecttest.txt", []() { // Windows
-    server.sendHeader("Location", "http://play.local/test.html", true);
-    server.send(302, "text/plain", "");
-  });
+  if (strcmp(request.path, "/generate_204") == 0 ||         // Android
+      strcmp(request.path, "/hotspot-detect.html") == 0 ||  // iOS/macOS
+      strcmp(request.path, "/connecttest.txt") == 0) {      // Windows
+    connection.addHeader("Location", "http://play.local/test.html");
+    connection.send(302, "text/plain", "");
+    return;
+  }
   */
   
+  // Relay counters and performance histograms (?reset=1 starts a new window)
+  if (strcmp(request.path, "/api/stats") == 0) {
+    handleStats(connection);
+    return;
+  }
+  
+  // Every game on the card, for lobby pages
+  if (strcmp(request.path, "/api/games") == 0) {
+    handleGames(connection);
+    return;
+  }
+  
   // Handle all other requests with file serving
-  server.onNotFound(handleFileRequest);
+  handleFileRequest(connection);
+}
+
+void HTTPServer::handleStats(HttpConnection& connection) {
+  JsonDocument doc;
+  doc["uptime"] = millis();
+  doc["freeHeap"] = ESP.getFreeHeap();
+  doc["clients"] = WebSocketRelay::getClientCount();
+  
+  const RelayStats& stats = WebSocketRelay::getStats();
+  JsonObject relay = doc["relay"].to<JsonObject>();
+  relay["messagesIn"] = stats.messagesIn;
+  relay["bytesIn"] = stats.bytesIn;
+  relay["messagesOut"] = stats.messagesOut;
+  relay["framesOut"] = stats.framesOut;
+  relay["bytesOut"] = stats.bytesOut;
+  relay["messagesDropped"] = stats.messagesDropped;
+  relay["slowSends"] = stats.slowSends;
+  relay["slowClientsDropped"] = stats.slowClientsDropped;
+  relay["idlePings"] = stats.idlePings;
+  relay["idleClientsDropped"] = stats.idleClientsDropped;
+  relay["messagesThrottled"] = stats.messagesThrottled;
+  relay["snapshotsCoalesced"] = stats.snapshotsCoalesced;
+  relay["deflatedMessages"] = stats.deflatedMessages;
+  relay["deflateBytesIn"] = stats.deflateBytesIn;
+  relay["deflateBytesOut"] = stats.deflateBytesOut;
+  relay["deflateMicros"] = stats.deflateMicros;
+  relay["deflateSkipped"] = stats.deflateSkipped;
+  relay["queuedMessages"] = stats.queuedMessages;
+  relay["queuedBytes"] = stats.queuedBytes;
+  relay["deltaUpdates"] = stats.deltaUpdates;
+  relay["deltaFullBytes"] = stats.deltaFullBytes;
+  relay["deltaSentBytes"] = stats.deltaSentBytes;
+  relay["deltaMicros"] = stats.deltaMicros;
+  
+  const FileCacheStats& cacheStats = FileCache::getStats();
+  JsonObject cache = doc["fileCache"].to<JsonObject>();
+  cache["hits"] = cacheStats.hits;
+  cache["misses"] = cacheStats.misses;
+  cache["uncacheable"] = cacheStats.uncacheable;
+  cache["evictions"] = cacheStats.evictions;
+  cache["entries"] = cacheStats.entries;
+  cache["bytesUsed"] = cacheStats.bytesUsed;
+  cache["budget"] = cacheStats.budget;
+  cache["psram"] = cacheStats.psram;
+  
+  const FileIndexStats& indexStats = FileIndex::getStats();
+  JsonObject index = doc["fileIndex"].to<JsonObject>();
+  index["ready"] = indexStats.ready;
+  index["files"] = indexStats.files;
+  index["memoryBytes"] = indexStats.memoryBytes;
+  index["scanMillis"] = indexStats.scanMillis;
   
-  Serial.println("Web server routes configured");
+  Logger::toJson(doc["log"].to<JsonObject>());
+  Metrics::toJson(doc["histograms"].to<JsonObject>());
+  
+  char reset[2];
+  if (connection.getRequest().getParam("reset", reset, sizeof(reset)) && reset[0] == '1') {
+    Metrics::reset();
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  connection.addHeader("Cache-Control", "no-store");
+  connection.send(200, "application/json", response);
+}
+
+// Serialized once per card, so this never touches the SD card
+void HTTPServer::handleGames(HttpConnection& connection) {
+  const String& games = GameCatalog::getJson();
+  
+  char etag[16];
+  snprintf(etag, sizeof(etag), "\"g%lx\"", (unsigned long)GameCatalog::getGeneration());
+  connection.addHeader("ETag", etag);
+  connection.addHeader("Cache-Control", "no-cache");
+  
+  if (isNotModified(connection.getRequest(), etag, nullptr)) {
+    connection.send(304, nullptr, "");
+    return;
+  }
+  connection.send(200, "application/json", games);
+}
+
+// Text formats that shrink well; images are compressed already
+bool HTTPServer::isCompressible(const String& filename) {
+  return filename.endsWith(".html") || filename.endsWith(".css") ||
+         filename.endsWith(".js") || filename.endsWith(".json") ||
+         filename.endsWith(".svg");
 }
 
 String HTTPServer::getContentType(const String& filename) {
@@ -42,10 +144,11 @@ String HTTPServer::getContentType(const String& filename) {
   return "text/plain";
 }
 
-void HTTPServer::handleFileRequest() {
-  String path = server.uri();
+void HTTPServer::handleFileRequest(HttpConnection& connection) {
+  const HttpRequest& request = connection.getRequest();
+  String path = request.path;
   
-  Serial.printf("HTTP Request: %s\n", path.c_str());
+  LOG_DEBUG(LogModule::HTTP, "HTTP Request: %s", path.c_str());
   
   // Default to index.html for root
   if (path == "/" || path == "") {
@@ -54,59 +157,341 @@ void HTTPServer::handleFileRequest() {
   
   // Check if SD card is available
   if (!SDCard::isMounted()) {
-    server.send(503, "text/html", 
+    connection.send(503, "text/html",
       "<html><body><h1>SD Card Error</h1><p>SD card not available</p></body></html>");
-    Serial.println("  -> 503: SD card not available");
+    LOG_WARN(LogModule::HTTP, "  -> 503: SD card not available");
     return;
   }
   
-  // Try to open file
-  if (SD.exists(path)) {
-    File file = SD.open(path, FILE_READ);
+  String contentType = getContentType(path);
+  bool compressible = isCompressible(path);
+  bool tryGzip = compressible && request.acceptsGzip;
+  if (compressible) {
+    connection.addHeader("Vary", "Accept-Encoding");
+  }
+  
+  FileResponse response;
+  String assetPath;
+  const Cartridge* cartridge = CartridgeStore::forPath(path, assetPath);
+  if (cartridge != nullptr) {
+    // Packed game: one seek into the .lpa instead of a directory walk
+    unsigned long lookupStarted = micros();
+    const CartridgeEntry* asset = tryGzip ? cartridge->find(assetPath + ".gz") : nullptr;
+    if (asset == nullptr) {
+      asset = cartridge->find(assetPath);
+    }
+    Metrics::lookupMicros.record(micros() - lookupStarted);
     
-    if (file) {
-      String contentType = getContentType(path);
-      size_t fileSize = file.size();
-      
-      Serial.printf("  -> 200: Serving %s (%d bytes, %s)\n", 
-                    path.c_str(), fileSize, contentType.c_str());
-      
-      server.streamFile(file, contentType);
-      file.close();
+    if (asset == nullptr) {
+      sendNotFound(connection, path);
+      return;
+    }
+    response.name = String(cartridge->path) + ":" + assetPath;
+    response.openPath = cartridge->path;
+    response.packed = true;
+    response.gzipped = (asset->flags & CARTRIDGE_FLAG_GZIP) != 0;
+    response.size = asset->length;
+    response.lastWrite = cartridge->lastWrite;
+    response.contentHash = asset->contentHash;
+    response.baseOffset = asset->offset;
+    
+    // Small assets come from RAM like loose files do, keyed by pack and path
+    if (FileCache::fits(asset->length)) {
+      response.cached = FileCache::get(response.name, response.openPath, asset->offset, asset->length);
+    }
+    sendFileResponse(connection, path, contentType, response);
+    return;
+  }
+  
+  // Which file to send - a precompressed sibling (foo.js.gz) when the
+  // browser takes gzip. The index answers without touching the card.
+  unsigned long lookupStarted = micros();
+  String filePath = path;
+  const FileEntry* entry = nullptr;
+  bool indexed = FileIndex::isReady();
+  bool found;
+  if (indexed) {
+    entry = tryGzip ? FileIndex::find(path + ".gz") : nullptr;
+    if (entry != nullptr) {
+      filePath = path + ".gz";
     } else {
-      server.send(500, "text/html", 
-        "<html><body><h1>File Error</h1><p>Could not open file</p></body></html>");
-      Serial.println("  -> 500: Could not open file");
+      entry = FileIndex::find(path);
     }
+    found = entry != nullptr;
   } else {
-    // File not found - send 404
-    String message = "<html><body style='font-family: Arial; padding: 20px;'>";
-    message += "<h1>404 - Not Found</h1>";
-    message += "<p>File not found: <code>" + path + "</code></p>";
-    message += "<p>Make sure files are on the SD card</p>";
-    message += "</body></html>";
-    
-    server.send(404, "text/html", message);
-    Serial.printf("  -> 404: File not found: %s\n", path.c_str());
+    if (tryGzip && SD.exists(path + ".gz")) {
+      filePath = path + ".gz";
+    }
+    found = filePath != path || SD.exists(path);
+  }
+  Metrics::lookupMicros.record(micros() - lookupStarted);
+  
+  if (!found) {
+    sendNotFound(connection, path);
+    return;
+  }
+  response.name = filePath;
+  response.openPath = filePath;
+  response.gzipped = filePath != path;
+  
+  // Hot files (every phone loads the same page at once) come from RAM. The
+  // index knows when a file is too big to be worth trying; without it, the
+  // cache hands back the file it opened to find out.
+  if (entry == nullptr || FileCache::fits(entry->size)) {
+    response.cached = FileCache::get(filePath, &response.file);
+  }
+  
+  // Validators come from the served file's size and mtime, so a repeat visit
+  // for a cached or indexed file is answered without touching the card
+  if (response.cached != nullptr) {
+    response.size = response.cached->size;
+    response.lastWrite = response.cached->lastWrite;
+  } else if (entry != nullptr) {
+    response.size = entry->size;
+    response.lastWrite = entry->lastWrite;
+  } else {
+    if (!response.file && !openFile(connection, filePath, response.file)) {
+      return;
+    }
+    response.size = response.file.size();
+    response.lastWrite = response.file.getLastWrite();
+  }
+  
+  sendFileResponse(connection, path, contentType, response);
+}
+
+void HTTPServer::sendNotFound(HttpConnection& connection, const String& path) {
+  String message = "<html><body style='font-family: Arial; padding: 20px;'>";
+  message += "<h1>404 - Not Found</h1>";
+  message += "<p>File not found: <code>" + path + "</code></p>";
+  message += "<p>Make sure files are on the SD card</p>";
+  message += "</body></html>";
+  
+  connection.send(404, "text/html", message);
+  LOG_INFO(LogModule::HTTP, "  -> 404: File not found: %s", path.c_str());
+}
+
+// Validators, conditional and range handling, then the body - the same for
+// a loose file and one inside a cartridge
+void HTTPServer::sendFileResponse(HttpConnection& connection, const String& path,
+                                  const String& contentType, FileResponse& response) {
+  const HttpRequest& request = connection.getRequest();
+  
+  // A cartridge carries a hash of each file's content; loose files go by
+  // size and mtime
+  char etag[32];
+  char lastModified[32];
+  if (response.packed) {
+    snprintf(etag, sizeof(etag), "\"c%08lx%s\"",
+             (unsigned long)response.contentHash, response.gzipped ? "-gz" : "");
+  } else {
+    snprintf(etag, sizeof(etag), "\"%x-%lx%s\"", (unsigned)response.size,
+             (unsigned long)response.lastWrite, response.gzipped ? "-gz" : "");
+  }
+  bool hasDate = formatHttpDate(response.lastWrite, lastModified, sizeof(lastModified));
+  
+  connection.addHeader("ETag", etag);
+  if (hasDate) {
+    connection.addHeader("Last-Modified", lastModified);
+  }
+  connection.addHeader("Cache-Control", cacheControlFor(path));
+  
+  if (isNotModified(request, etag, hasDate ? lastModified : nullptr)) {
+    LOG_INFO(LogModule::HTTP, "  -> 304: %s not modified", response.name.c_str());
+    if (response.file) {
+      response.file.close();
+    }
+    FileCache::release(response.cached);
+    connection.send(304, nullptr, "");
+    return;
+  }
+  
+  if (response.gzipped) {
+    connection.addHeader("Content-Encoding", "gzip");
+  }
+  
+  // Media elements seek with Range requests; answer with just that part
+  connection.addHeader("Accept-Ranges", "bytes");
+  int code = 200;
+  size_t offset = 0;
+  size_t length = response.size;
+  if (request.range[0] != '\0' && rangeStillValid(request, etag, hasDate ? lastModified : nullptr)) {
+    char contentRange[48];
+    RangeResult range = HttpRequest::parseRange(request.range, response.size, offset, length);
+    if (range == RangeResult::UNSATISFIABLE) {
+      LOG_INFO(LogModule::HTTP, "  -> 416: %s (%s)", response.name.c_str(), request.range);
+      if (response.file) {
+        response.file.close();
+      }
+      FileCache::release(response.cached);
+      snprintf(contentRange, sizeof(contentRange), "bytes */%u", (unsigned)response.size);
+      connection.addHeader("Content-Range", contentRange);
+      connection.send(416, "text/plain", "");
+      return;
+    }
+    if (range == RangeResult::PARTIAL) {
+      code = 206;
+      snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u",
+               (unsigned)offset, (unsigned)(offset + length - 1), (unsigned)response.size);
+      connection.addHeader("Content-Range", contentRange);
+    }
+  }
+  
+  if (response.cached == nullptr && !response.file &&
+      !openFile(connection, response.openPath, response.file)) {
+    return;
   }
+  
+  // The connection sends the body a slice at a time from process()
+  if (response.cached != nullptr) {
+    LOG_INFO(LogModule::HTTP, "  -> %d: Serving %s (%u of %u bytes, %s, cached)", code,
+             response.name.c_str(), (unsigned)length, (unsigned)response.size, contentType.c_str());
+             
+    connection.sendCached(code, contentType.c_str(), response.cached, offset, length);
+  } else {
+    LOG_INFO(LogModule::HTTP, "  -> %d: Serving %s (%u of %u bytes, %s)", code,
+             response.name.c_str(), (unsigned)length, (unsigned)response.size, contentType.c_str());
+             
+    connection.sendFile(code, contentType.c_str(), response.file,
+                        response.baseOffset + offset, length);
+  }
+}
+
+// If-Range: only send part of the file if it's the version the browser
+// already has the rest of
+bool HTTPServer::rangeStillValid(const HttpRequest& request, const char* etag, const char* lastModified) {
+  if (request.ifRange[0] == '\0') {
+    return true;
+  }
+  if (request.ifRange[0] == '"') {
+    return strcmp(request.ifRange, etag) == 0;
+  }
+  return lastModified != nullptr && strcmp(request.ifRange, lastModified) == 0;
 }
 
-bool HTTPServer::start(uint16_t port) {
+// Sends a 500 if the file can't be opened
+bool HTTPServer::openFile(HttpConnection& connection, const String& path, File& file) {
+  file = SD.open(path, FILE_READ);
+  if (!file) {
+    // Validators for a file we couldn't send would get the error cached
+    connection.clearHeaders();
+    connection.send(500, "text/html",
+      "<html><body><h1>File Error</h1><p>Could not open file</p></body></html>");
+    LOG_ERROR(LogModule::HTTP, "  -> 500: Could not open file");
+    return false;
+  }
+  return true;
+}
+
+// If-None-Match wins over If-Modified-Since when both are sent (RFC 9110).
+// Browsers echo our Last-Modified back verbatim, so a string compare does.
+bool HTTPServer::isNotModified(const HttpRequest& request, const char* etag, const char* lastModified) {
+  if (request.ifNoneMatch[0] != '\0') {
+    return strcmp(request.ifNoneMatch, "*") == 0 || strstr(request.ifNoneMatch, etag) != nullptr;
+  }
+  if (lastModified != nullptr && request.ifModifiedSince[0] != '\0') {
+    return strcmp(request.ifModifiedSince, lastModified) == 0;
+  }
+  return false;
+}
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT". False when the file has
+// no usable timestamp (FAT without a clock).
+bool HTTPServer::formatHttpDate(time_t t, char* out, size_t size) {
+  if (t <= 0) {
+    return false;
+  }
+  
+  struct tm parts;
+  gmtime_r(&t, &parts);
+  return strftime(out, size, "%a, %d %b %Y %H:%M:%S GMT", &parts) > 0;
+}
+
+// A game's manifest can set its own policy for files under /games/<folder>/
+const char* HTTPServer::cacheControlFor(const String& path) {
+  if (path.startsWith("/games/")) {
+    int slash = path.indexOf('/', 7);
+    if (slash > 7) {
+      String folder = path.substring(7, slash);
+      const GameManifest* manifest = GameCatalog::find(folder.c_str());
+      if (manifest != nullptr && manifest->cacheControl[0] != '\0') {
+        return manifest->cacheControl;
+      }
+    }
+  }
+  return defaultCacheControl.c_str();
+}
+
+bool HTTPServer::start(const SystemConfig& config, uint16_t port) {
   Serial.println("\n--- Starting Web Server ---");
   
-  setupRoutes();
-  server.begin();
+  defaultCacheControl = config.httpCacheControl;
+  listener.begin(port);
+  listener.setNoDelay(true);
   
-  Serial.printf("Web Server started on port %d\n", port);
+  Serial.printf("Web Server started on port %d (%d connections)\n", port, MAX_CONNECTIONS);
   Serial.println("Ready to serve files from SD card!");
   
   return true;
 }
 
 void HTTPServer::process() {
-  server.handleClient();
+  acceptClients();
+  
+  // Lookups, opens and file reads all happen in here; the UI task's card
+  // checks wait for the pass to finish
+  SDLock sd;
+  
+  // Every connection gets a slice each pass, so one big download can't
+  // hold up the others (or the relay)
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    if (connections[i].poll()) {
+      route(connections[i]);
+    }
+  }
+}
+
+bool HTTPServer::isSending() {
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    if (connections[i].getState() == HttpState::SENDING) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HTTPServer::acceptClients() {
+  while (listener.hasClient()) {
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < MAX_CONNECTIONS && slot < 0; i++) {
+      if (connections[i].getState() == HttpState::FREE) {
+        slot = i;
+      }
+    }
+    
+    // All busy: make room by closing a kept-alive connection with nothing
+    // to do; otherwise the newcomer waits in the backlog
+    for (uint8_t i = 0; i < MAX_CONNECTIONS && slot < 0; i++) {
+      if (connections[i].isIdle()) {
+        connections[i].close();
+        slot = i;
+      }
+    }
+    if (slot < 0) {
+      return;
+    }
+    
+    WiFiClient client = listener.available();
+    if (!client) {
+      return;
+    }
+    connections[slot].accept(client);
+  }
 }
 
 void HTTPServer::stop() {
-  server.stop();
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    connections[i].close();
+  }
+  listener.end();
 }
@@ -1,29 +1,64 @@
 #ifndef WEB_SERVER_H
 #define WEB_SERVER_H
 
-#include <WebServer.h>
+#include <WiFi.h>
+#include "http_connection.h"
 #include "storage/sd_card.h"
+#include "storage/config.h"
 
 class HTTPServer {
 public:
   // Start HTTP server
-  static bool start(uint16_t port = 80);
+  static bool start(const SystemConfig& config, uint16_t port = 80);
   
   // Process HTTP requests (call in loop)
   static void process();
   
+  // A response is going out: call process() again soon
+  static bool isSending();
+  
   // Stop HTTP server
   static void stop();
 
 private:
-  static WebServer server;
+  static const uint8_t MAX_CONNECTIONS = 4;
+  static WiFiServer listener;
+  static HttpConnection connections[MAX_CONNECTIONS];
+  static String defaultCacheControl;   // Cache-Control unless a manifest overrides it
+  
+  // What handleFileRequest resolved a request to, loose or packed
+  struct FileResponse {
+    String name;                        // For the log
+    String openPath;                    // File to open if it isn't open or cached
+    bool packed = false;                // Inside a cartridge (.lpa)
+    bool gzipped = false;
+    size_t size = 0;
+    time_t lastWrite = 0;
+    uint32_t contentHash = 0;           // Cartridge assets only
+    size_t baseOffset = 0;              // Where the body starts in the file
+    const CachedFile* cached = nullptr;
+    File file;
+  };
+  
+  static void acceptClients();
   
   // Route handlers
-  static void setupRoutes();
-  static void handleFileRequest();
+  static void route(HttpConnection& connection);
+  static void handleFileRequest(HttpConnection& connection);
+  static void handleStats(HttpConnection& connection);
+  static void handleGames(HttpConnection& connection);
+  static void sendFileResponse(HttpConnection& connection, const String& path,
+                               const String& contentType, FileResponse& response);
+  static void sendNotFound(HttpConnection& connection, const String& path);
   
   // Helper functions
   static String getContentType(const String& filename);
+  static bool isCompressible(const String& filename);
+  static bool rangeStillValid(const HttpRequest& request, const char* etag, const char* lastModified);
+  static bool openFile(HttpConnection& connection, const String& path, File& file);
+  static bool isNotModified(const HttpRequest& request, const char* etag, const char* lastModified);
+  static bool formatHttpDate(time_t t, char* out, size_t size);
+  static const char* cacheControlFor(const String& path);
 };
 
 #endif
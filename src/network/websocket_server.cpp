@@ -1,33 +1,98 @@
 #include "websocket_server.h"
+#include "utils/metrics.h"
+#include "utils/logger.h"
+#include "storage/sd_card.h"
+#include <esp_timer.h>
 
 WebSocketsServer WebSocketRelay::server(81);
-std::map<uint8_t, PlayerClient> WebSocketRelay::clients;
+ClientRegistry WebSocketRelay::clients;
+SessionTable WebSocketRelay::sessions;
+Room WebSocketRelay::rooms[MAX_ROOMS];
+RelayStats WebSocketRelay::stats = {};
+ClientOutbox WebSocketRelay::outboxes[WEBSOCKETS_SERVER_CLIENT_MAX];
+ClientLimits WebSocketRelay::limits[WEBSOCKETS_SERVER_CLIENT_MAX];
+uint32_t WebSocketRelay::defaultMessageRate = 0;
+uint32_t WebSocketRelay::defaultByteRate = 0;
+bool WebSocketRelay::throttleNotices = false;
+uint64_t WebSocketRelay::receivedAt = 0;
+uint8_t* WebSocketRelay::stampBuffer = nullptr;
+size_t WebSocketRelay::stampBufferSize = 0;
+DeflateEncoder WebSocketRelay::deflater;
+uint8_t* WebSocketRelay::deflateBuffer = nullptr;
+size_t WebSocketRelay::deflateBufferSize = 0;
+size_t WebSocketRelay::deflateThreshold = 0;
+uint32_t WebSocketRelay::deflateClients = 0;
+uint8_t* WebSocketRelay::batchBuffer = nullptr;
+unsigned long WebSocketRelay::batchInterval = 0;
+unsigned long WebSocketRelay::lastFlush = 0;
+size_t WebSocketRelay::queueMessageLimit = 64;
+unsigned long WebSocketRelay::slowClientTimeout = 0;
+size_t WebSocketRelay::snapshotLimit = 0;
+bool WebSocketRelay::deltaEnabled = false;
+uint16_t WebSocketRelay::keyframeInterval = 30;
+unsigned long WebSocketRelay::defaultGracePeriod = 0;
+unsigned long WebSocketRelay::lastSessionCheck = 0;
+TimerWheel WebSocketRelay::idleTimers;
+unsigned long WebSocketRelay::idlePingAfter = 0;
+unsigned long WebSocketRelay::idleTimeout = 0;
+
+// Message types starting with this prefix are addressed to the relay itself
+static const char* CONTROL_PREFIX = "relay_";
+
+// A send that takes this long means the client's TCP window is full
+static const unsigned long SLOW_SEND_MS = 20;
+
+// After a slow send, hold that client's messages in its queue for a while
+// instead of stalling the loop on it again
+static const unsigned long SLOW_BACKOFF_MS = 100;
+
+// How often parked sessions are checked for expiry
+static const unsigned long SESSION_CHECK_MS = 1000;
+
+// Idle timer resolution (64 slots, so one turn of the wheel is 16 s)
+static const unsigned long IDLE_TICK_MS = 250;
+
+// At most one relay_throttled notice per client this often
+static const unsigned long THROTTLE_NOTICE_MS = 1000;
 
 void WebSocketRelay::onEvent(uint8_t clientNum, WStype_t type, uint8_t* payload, size_t length) {
   switch(type) {
     case WStype_DISCONNECTED:
       {
-        Serial.printf("[WS] Client #%u disconnected\n", clientNum);
+        LOG_INFO(LogModule::RELAY, "[WS] Client #%u disconnected", clientNum);
         
         // Remove from client registry
-        if (clients.find(clientNum) != clients.end()) {
-          String uuid = clients[clientNum].uuid;
-          clients.erase(clientNum);
-          Serial.printf("  Removed client with UUID: %s\n", uuid.c_str());
-          Serial.printf("  Active clients: %d\n", clients.size());
+        PlayerClient* client = clients.get(clientNum);
+        if (client != nullptr) {
+          char uuid[UUID_MAX_LENGTH + 1];
+          memcpy(uuid, client->uuid, sizeof(uuid));
+          uint8_t room = client->room;
           
-          // Notify other clients about disconnect
-          JsonDocument doc;
-          doc["type"] = "player_disconnected";
-          doc["uuid"] = uuid;
-          doc["timestamp"] = millis();
+          // A reload can register the same UUID on a new connection before
+          // the old one times out - then the player never really left
+          bool registered = uuid[0] != '\0';
+          bool replaced = registered && clients.findUuid(uuid) != clientNum;
           
-          String message;
-          serializeJson(doc, message);
+          // Otherwise hold their place for the grace period and stay quiet
+          unsigned long grace = rooms[room].gracePeriod;
+          bool parked = registered && !replaced && grace > 0 &&
+                        sessions.park(uuid, room, clientNum, millis() + grace);
+          if (parked) {
+            rooms[room].parkedSessions++;
+          }
+          
+          leaveRoom(clientNum);
+          clients.disconnect(clientNum);
+          idleTimers.cancel(clientNum);
+          deflateClients &= ~(1UL << clientNum);
+          outboxes[clientNum].queue.clear();
+          LOG_INFO(LogModule::RELAY, "  Removed client with UUID: %s", uuid);
+          LOG_INFO(LogModule::RELAY, "  Active clients: %d", clients.count());
           
-          // Broadcast to all remaining clients
-          for (auto& client : clients) {
-            server.sendTXT(client.first, message);
+          if (parked) {
+            LOG_INFO(LogModule::RELAY, "  Holding session for %lu s", grace / 1000);
+          } else if (!replaced) {
+            announceDisconnect(room, uuid, clientNum);
           }
         }
       }
@@ -36,86 +101,1130 @@ void WebSocketRelay::onEvent(uint8_t clientNum, WStype_t type, uint8_t* payload,
     case WStype_CONNECTED:
       {
         IPAddress ip = server.remoteIP(clientNum);
-        Serial.printf("[WS] Client #%u connected from %s\n", clientNum, ip.toString().c_str());
+        LOG_INFO(LogModule::RELAY, "[WS] Client #%u connected from %s", clientNum, ip.toString().c_str());
         
         // Initialize client entry (UUID will be set when client sends it)
-        PlayerClient newClient;
-        newClient.uuid = "";
-        newClient.lastSeen = millis();
-        clients[clientNum] = newClient;
+        PlayerClient& client = clients.connect(clientNum);
+        outboxes[clientNum].queue.clear();
+        outboxes[clientNum].blockedUntil = 0;
+        outboxes[clientNum].overflowing = false;
+        limits[clientNum].messages.reset(rooms[0].messageRate, client.lastSeen);
+        limits[clientNum].bytes.reset(rooms[0].byteRate, client.lastSeen);
+        limits[clientNum].throttled = 0;
+        limits[clientNum].lastNotice = 0;
+        limits[clientNum].pendingSnapshot = false;
+        rooms[0].members |= (1UL << clientNum);
+        if (idleTimeout > 0) {
+          idleTimers.schedule(clientNum, client.lastSeen + idlePingAfter);
+        }
+        
+        // Clients may pick a room up front with ws://host:81/?room=name
+        char roomName[ROOM_NAME_MAX_LENGTH + 1];
+        if (parseQueryParam((const char*)payload, "room", roomName, sizeof(roomName))) {
+          joinRoom(clientNum, roomName);
+        }
+        
+        // ...and say which game it is (&game=folder) for its manifest settings
+        char game[GAME_FOLDER_MAX_LENGTH + 1];
+        if (parseQueryParam((const char*)payload, "game", game, sizeof(game))) {
+          setRoomGame(client.room, game);
+        }
+        
+        // &deflate=1: large broadcasts may arrive as compressed binary frames
+        char deflate[2];
+        if (parseQueryParam((const char*)payload, "deflate", deflate, sizeof(deflate)) &&
+            deflate[0] == '1') {
+          deflateClients |= (1UL << clientNum);
+        } else {
+          deflateClients &= ~(1UL << clientNum);
+        }
         
         // Send welcome message
         JsonDocument doc;
         doc["type"] = "connected";
         doc["message"] = "Welcome to LAN Party Arcade!";
         doc["clientNum"] = clientNum;
+        doc["room"] = rooms[client.room].name;
         doc["timestamp"] = millis();
         
         String message;
         serializeJson(doc, message);
-        server.sendTXT(clientNum, message);
+        sendToClient(clientNum, (const uint8_t*)message.c_str(), message.length());
+        
+        // Bring the newcomer up to date without waiting for the host
+        sendSnapshot(clientNum);
         
-        Serial.printf("  Active clients: %d\n", clients.size());
+        LOG_INFO(LogModule::RELAY, "  Room: '%s'", rooms[client.room].name);
+        LOG_INFO(LogModule::RELAY, "  Active clients: %d", clients.count());
       }
       break;
       
     case WStype_TEXT:
+    case WStype_BIN:
       {
-        String message = String((char*)payload);
-        Serial.printf("[WS] Client #%u sent: %s\n", clientNum, message.c_str());
+        // Time from receiving a message to handing the last copy to a
+        // socket (or queue), and how many players it went to
+        unsigned long started = micros();
+        uint32_t deliveriesBefore = stats.messagesOut;
+        receivedAt = esp_timer_get_time();
         
-        // Update last seen time
-        if (clients.find(clientNum) != clients.end()) {
-          clients[clientNum].lastSeen = millis();
+        if (type == WStype_TEXT) {
+          relayText(clientNum, payload, length);
+        } else {
+          relayBinary(clientNum, payload, length);
         }
         
-        // Try to parse as JSON to extract UUID
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, message);
-        
-        if (!error && doc["uuid"].is<String>()) {
-          String uuid = doc["uuid"].as<String>();
-          
-          // Store/update UUID for this client
-          if (clients.find(clientNum) != clients.end()) {
-            if (clients[clientNum].uuid.length() == 0) {
-              clients[clientNum].uuid = uuid;
-              Serial.printf("  Registered UUID: %s\n", uuid.c_str());
-            }
-          }
-        }
-        
-        // RELAY MODE: Broadcast to ALL other clients (pure relay)
-        int relayCount = 0;
-        for (auto& client : clients) {
-          if (client.first != clientNum) { // Don't echo back to sender
-            server.sendTXT(client.first, payload, length);
-            relayCount++;
-          }
-        }
-        
-        Serial.printf("  Relayed to %d clients\n", relayCount);
+        Metrics::relayMicros.record(micros() - started);
+        Metrics::fanOut.record(stats.messagesOut - deliveriesBefore);
+        Metrics::bytesIn.record(length);
       }
       break;
       
-    case WStype_BIN:
-      Serial.printf("[WS] Client #%u sent binary data (%u bytes) - ignored\n", clientNum, length);
-      break;
-      
     case WStype_ERROR:
-      Serial.printf("[WS] Client #%u error\n", clientNum);
+      LOG_WARN(LogModule::RELAY, "[WS] Client #%u error", clientNum);
       break;
       
     case WStype_PING:
     case WStype_PONG:
-      // Handled automatically by library
+      {
+        // Replies are handled by the library; either way the client is alive
+        PlayerClient* client = clients.get(clientNum);
+        if (client != nullptr) {
+          client->lastSeen = millis();
+        }
+      }
+      break;
+      
+    default:
       break;
   }
 }
 
-bool WebSocketRelay::start(uint16_t port) {
+void WebSocketRelay::relayText(uint8_t clientNum, uint8_t* payload, size_t length) {
+  PlayerClient* found = clients.get(clientNum);
+  if (found == nullptr) {
+    return;
+  }
+  
+  PlayerClient& client = *found;
+  client.lastSeen = millis();
+  stats.messagesIn++;
+  stats.bytesIn += length;
+  
+  // One bounded pass over the top-level keys, looking for "type" (to
+  // spot control messages) and the optional "to" address. The UUID and
+  // game can only be set once, so only unregistered clients look for them.
+  static const char* const FIELDS[] = { "type", "to", "snapshot", "stamp", "uuid", "game" };
+  JsonSpan fields[6];
+  bool registered = client.uuid[0] != '\0';
+  JsonScanner::scanObject(payload, length, FIELDS, fields, registered ? 4 : 6);
+  
+  if (!registered) {
+    char uuid[UUID_MAX_LENGTH + 1];
+    if (JsonScanner::copyString(fields[4], uuid, sizeof(uuid))) {
+      uint8_t previous = clients.findUuid(uuid);
+      if (clients.registerUuid(clientNum, uuid)) {
+        LOG_INFO(LogModule::RELAY, "[WS] Client #%u registered UUID: %s", clientNum, uuid);
+        
+        char game[GAME_FOLDER_MAX_LENGTH + 1];
+        if (JsonScanner::copyString(fields[5], game, sizeof(game))) {
+          setRoomGame(client.room, game);
+        }
+        resumeSession(clientNum, uuid, previous);
+      }
+    }
+  }
+  
+  bool control = fields[0].startsWith(CONTROL_PREFIX);
+  bool snapshot = !control && fields[2].length == 4 && memcmp(fields[2].data, "true", 4) == 0;
+  
+  // Over its rate limit: drop it (control messages too - relay_resync
+  // isn't free). A throttled snapshot is kept instead, and the newest one
+  // goes out as soon as the sender has budget again.
+  if (!admit(clientNum, client.room, length)) {
+    if (snapshot && !fields[1].isPresent() && !deltaEnabled) {
+      storeSnapshot(client.room, clientNum, payload, length);
+      limits[clientNum].pendingSnapshot = true;
+      stats.snapshotsCoalesced++;
+    }
+    return;
+  }
+  
+  if (control) {
+    handleControlMessage(clientNum, fields[0], payload, length);
+    return;
+  }
+  
+  // "stamp": true asks for the server receive time, for games that need to
+  // know who acted first
+  if (fields[3].length == 4 && memcmp(fields[3].data, "true", 4) == 0) {
+    size_t stamped = stampMessage(payload, length);
+    if (stamped > 0) {
+      payload = stampBuffer;
+      length = stamped;
+    }
+  }
+  
+  // Addressed messages only go to the listed players (never back to the
+  // sender, never outside the room). Unknown UUIDs are simply skipped.
+  if (fields[1].isPresent()) {
+    uint32_t targets = resolveTargets(fields[1], client.room);
+    sendToMask(targets & ~(1UL << clientNum), payload, length);
+    return;
+  }
+  
+  // Full-state broadcasts tagged "snapshot": true are kept for late joiners
+  if (snapshot) {
+    if (deltaEnabled) {
+      relayState(client.room, clientNum, payload, length);
+      return;
+    }
+    storeSnapshot(client.room, clientNum, payload, length);
+  }
+  
+  // RELAY MODE: Forward to everyone else in the sender's room
+  sendToRoom(client.room, clientNum, payload, length);
+}
+
+void WebSocketRelay::handleControlMessage(uint8_t clientNum, const JsonSpan& type,
+                                          const uint8_t* payload, size_t length) {
+  if (type.equals("relay_join")) {
+    // { "type": "relay_join", "room": "poker" }
+    char roomName[ROOM_NAME_MAX_LENGTH + 1];
+    if (!JsonScanner::findString(payload, length, "room", roomName, sizeof(roomName))) {
+      roomName[0] = '\0';
+    }
+    
+    bool joined = joinRoom(clientNum, roomName);
+    uint8_t room = clients.get(clientNum)->room;
+    
+    char game[GAME_FOLDER_MAX_LENGTH + 1];
+    if (joined && JsonScanner::findString(payload, length, "game", game, sizeof(game))) {
+      setRoomGame(room, game);
+    }
+    
+    JsonDocument doc;
+    doc["type"] = "relay_joined";
+    doc["room"] = rooms[room].name;
+    doc["members"] = __builtin_popcount(rooms[room].members);
+    if (!joined) {
+      doc["error"] = "no_free_rooms";
+    }
+    
+    String message;
+    serializeJson(doc, message);
+    sendToClient(clientNum, (const uint8_t*)message.c_str(), message.length());
+    sendSnapshot(clientNum);
+    
+    LOG_INFO(LogModule::RELAY, "[WS] Client #%u joined room '%s'", clientNum, rooms[room].name);
+    return;
+  }
+  
+  if (type.equals("relay_ping")) {
+    sendPong(clientNum, payload, length);
+    return;
+  }
+  
+  if (type.equals("relay_resync")) {
+    // Delta mode: client missed a patch, send the full state again
+    sendSnapshot(clientNum);
+    return;
+  }
+  
+  LOG_WARN(LogModule::RELAY, "[WS] Client #%u sent unknown control message - ignored", clientNum);
+}
+
+int WebSocketRelay::findRoom(const char* name) {
+  for (uint8_t i = 0; i < MAX_ROOMS; i++) {
+    if (rooms[i].inUse && strcmp(rooms[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int WebSocketRelay::acquireRoom(const char* name) {
+  int existing = findRoom(name);
+  if (existing >= 0) {
+    return existing;
+  }
+  
+  for (uint8_t i = 1; i < MAX_ROOMS; i++) {
+    if (!rooms[i].inUse) {
+      rooms[i].inUse = true;
+      strncpy(rooms[i].name, name, ROOM_NAME_MAX_LENGTH);
+      rooms[i].name[ROOM_NAME_MAX_LENGTH] = '\0';
+      rooms[i].members = 0;
+      rooms[i].snapshotLength = 0;
+      rooms[i].game[0] = '\0';
+      rooms[i].gracePeriod = defaultGracePeriod;
+      rooms[i].parkedSessions = 0;
+      rooms[i].messageRate = defaultMessageRate;
+      rooms[i].byteRate = defaultByteRate;
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool WebSocketRelay::joinRoom(uint8_t clientNum, const char* name) {
+  PlayerClient* client = clients.get(clientNum);
+  if (client == nullptr) {
+    return false;
+  }
+  
+  int room = acquireRoom(name);
+  if (room < 0) {
+    return false;
+  }
+  
+  moveToRoom(clientNum, room);
+  return true;
+}
+
+void WebSocketRelay::moveToRoom(uint8_t clientNum, uint8_t room) {
+  PlayerClient* client = clients.get(clientNum);
+  if (client == nullptr || room == client->room) {
+    return;
+  }
+  
+  leaveRoom(clientNum);
+  client->room = room;
+  rooms[room].members |= (1UL << clientNum);
+  limits[clientNum].pendingSnapshot = false;
+}
+
+void WebSocketRelay::leaveRoom(uint8_t clientNum) {
+  PlayerClient* client = clients.get(clientNum);
+  if (client == nullptr) {
+    return;
+  }
+  
+  rooms[client->room].members &= ~(1UL << clientNum);
+  releaseRoomIfEmpty(client->room);
+}
+
+void WebSocketRelay::releaseRoomIfEmpty(uint8_t index) {
+  Room& room = rooms[index];
+  if (room.members != 0 || room.parkedSessions != 0) {
+    return;
+  }
+  
+  // Nobody left playing: the next game to arrive sets the rules
+  room.game[0] = '\0';
+  room.gracePeriod = defaultGracePeriod;
+  room.messageRate = defaultMessageRate;
+  room.byteRate = defaultByteRate;
+  
+  // Named rooms are released once empty (and nobody is due back) so the
+  // slot can be reused
+  if (index != 0) {
+    room.inUse = false;
+    room.snapshotLength = 0;
+    room.stateVersion = 0;
+    if (room.state != nullptr) {
+      room.state->clear();
+    }
+  }
+}
+
+// The first game to claim a room sets its rules until the room empties. A
+// later client naming the same game changes nothing, and one naming another
+// game can't loosen the limits on the players already there.
+void WebSocketRelay::setRoomGame(uint8_t room, const char* folder) {
+  Room& target = rooms[room];
+  if (target.game[0] != '\0') {
+    if (strcmp(target.game, folder) != 0) {
+      LOG_WARN(LogModule::RELAY, "[WS] Room '%s' is playing '%s' - ignoring claim for '%s'",
+               target.name, target.game, folder);
+    }
+    return;
+  }
+  
+  // Only held for a rescan's swap (or an entry it's reading), never a scan
+  SDLock sd;
+  const GameManifest* manifest = GameCatalog::find(folder);
+  if (manifest == nullptr) {
+    return;
+  }
+  
+  strncpy(target.game, manifest->folder, GAME_FOLDER_MAX_LENGTH);
+  target.game[GAME_FOLDER_MAX_LENGTH] = '\0';
+  if (manifest->reconnectGracePeriod >= 0) {
+    target.gracePeriod = manifest->reconnectGracePeriod * 1000UL;
+  }
+  if (manifest->maxMessagesPerSecond >= 0) {
+    target.messageRate = manifest->maxMessagesPerSecond;
+  }
+  if (manifest->maxBytesPerSecond >= 0) {
+    target.byteRate = manifest->maxBytesPerSecond;
+  }
+}
+
+// { "type": "relay_pong", "t0": <client's t0, echoed>, "t1": <received µs>, "t2": <sent µs> }
+// Built with snprintf and sent straight away, so t2 is as close to the
+// real send time as we can get without hooking the socket.
+void WebSocketRelay::sendPong(uint8_t clientNum, const uint8_t* payload, size_t length) {
+  // Echo t0 verbatim, but only if it looks like a number
+  JsonSpan t0;
+  static const char* const KEYS[] = { "t0" };
+  JsonScanner::scanObject(payload, length, KEYS, &t0, 1);
+  
+  bool numeric = t0.isPresent() && t0.length <= 24;
+  for (size_t i = 0; numeric && i < t0.length; i++) {
+    char c = t0.data[i];
+    numeric = isdigit((unsigned char)c) || c == '.' || c == '-' || c == 'e' || c == 'E' || c == '+';
+  }
+  
+  char message[128];
+  int n = snprintf(message, sizeof(message),
+                   "{\"type\":\"relay_pong\",\"t0\":%.*s,\"t1\":%llu,\"t2\":%llu}",
+                   numeric ? (int)t0.length : 4, numeric ? (const char*)t0.data : "null",
+                   (unsigned long long)receivedAt, (unsigned long long)esp_timer_get_time());
+                   
+  // Ahead of anything queued for this client: the pong doesn't care about
+  // ordering, and waiting for a batch tick would skew the measurement
+  if (isBlocked(clientNum)) {
+    sendToClient(clientNum, (const uint8_t*)message, n);
+  } else {
+    stats.messagesOut++;
+    sendFrame(clientNum, (const uint8_t*)message, n);
+  }
+}
+
+// {"serverTime":<received µs>, ...rest of the original object...}
+size_t WebSocketRelay::stampMessage(const uint8_t* payload, size_t length) {
+  size_t start = 0;
+  while (start < length && isspace(payload[start])) {
+    start++;
+  }
+  if (start >= length || payload[start] != '{') {
+    return 0;
+  }
+  start++;
+  
+  // Allocated on first use, then kept; stamped messages must fit a queue
+  if (stampBuffer == nullptr) {
+    stampBuffer = (uint8_t*)malloc(outboxes[0].queue.getCapacity());
+    stampBufferSize = stampBuffer ? outboxes[0].queue.getCapacity() : 0;
+  }
+  
+  char prefix[40];
+  int n = snprintf(prefix, sizeof(prefix), "{\"serverTime\":%llu", (unsigned long long)receivedAt);
+  
+  size_t rest = length - start;
+  size_t total = n + 1 + rest;
+  if (total > stampBufferSize) {
+    return 0;
+  }
+  
+  // A comma unless the object was empty
+  size_t next = start;
+  while (next < length && isspace(payload[next])) {
+    next++;
+  }
+  bool empty = next < length && payload[next] == '}';
+  
+  memcpy(stampBuffer, prefix, n);
+  if (!empty) {
+    stampBuffer[n++] = ',';
+  }
+  memcpy(stampBuffer + n, payload + start, rest);
+  return n + rest;
+}
+
+bool WebSocketRelay::spendBudget(uint8_t clientNum, uint8_t room, size_t length) {
+  const Room& limit = rooms[room];
+  ClientLimits& budget = limits[clientNum];
+  unsigned long now = millis();
+  
+  // Burst allowance is one second's worth
+  bool allowed =
+    (limit.messageRate == 0 || budget.messages.canTake(1, limit.messageRate, limit.messageRate, now)) &&
+    (limit.byteRate == 0 || budget.bytes.canTake(length, limit.byteRate, limit.byteRate, now));
+  if (!allowed) {
+    return false;
+  }
+  
+  if (limit.messageRate > 0) {
+    budget.messages.take(1, limit.messageRate, limit.messageRate, now);
+  }
+  if (limit.byteRate > 0) {
+    budget.bytes.take(length, limit.byteRate, limit.byteRate, now);
+  }
+  return true;
+}
+
+bool WebSocketRelay::admit(uint8_t clientNum, uint8_t room, size_t length) {
+  if (spendBudget(clientNum, room, length)) {
+    return true;
+  }
+  
+  ClientLimits& budget = limits[clientNum];
+  budget.throttled++;
+  stats.messagesThrottled++;
+  
+  // { "type": "relay_throttled", "dropped": 12 } - at most once a second
+  unsigned long now = millis();
+  if (throttleNotices && (budget.lastNotice == 0 || now - budget.lastNotice >= THROTTLE_NOTICE_MS)) {
+    JsonDocument doc;
+    doc["type"] = "relay_throttled";
+    doc["dropped"] = budget.throttled;
+    
+    String message;
+    serializeJson(doc, message);
+    sendToClient(clientNum, (const uint8_t*)message.c_str(), message.length());
+    
+    LOG_WARN(LogModule::RELAY, "[WS] Client #%u over its rate limit (%lu dropped)",
+             clientNum, (unsigned long)budget.throttled);
+    budget.throttled = 0;
+    budget.lastNotice = now;
+  }
+  return false;
+}
+
+void WebSocketRelay::flushCoalesced(uint8_t clientNum) {
+  PlayerClient* client = clients.get(clientNum);
+  if (client == nullptr) {
+    return;
+  }
+  
+  // Someone else's snapshot has replaced it since: theirs is newer, and
+  // it isn't this client's to send (or be charged for)
+  const Room& room = rooms[client->room];
+  if (room.snapshotLength == 0 || room.snapshotOwner != clientNum) {
+    limits[clientNum].pendingSnapshot = false;
+    return;
+  }
+  
+  if (spendBudget(clientNum, client->room, room.snapshotLength)) {
+    limits[clientNum].pendingSnapshot = false;
+    sendToRoom(client->room, clientNum, room.snapshot, room.snapshotLength);
+  }
+}
+
+bool WebSocketRelay::parseQueryParam(const char* url, const char* name, char* out, size_t outSize) {
+  if (url == nullptr) {
+    return false;
+  }
+  
+  const char* query = strchr(url, '?');
+  if (query == nullptr) {
+    return false;
+  }
+  
+  // Find "name=" at the start of a query parameter
+  size_t nameLength = strlen(name);
+  const char* param = query + 1;
+  while (param != nullptr && *param != '\0') {
+    if (strncmp(param, name, nameLength) == 0 && param[nameLength] == '=') {
+      const char* value = param + nameLength + 1;
+      size_t n = 0;
+      while (value[n] != '\0' && value[n] != '&') {
+        char c = value[n];
+        bool valid = isalnum((unsigned char)c) || c == '_' || c == '-';
+        if (!valid || n + 1 >= outSize) {
+          return false;
+        }
+        out[n] = c;
+        n++;
+      }
+      out[n] = '\0';
+      return n > 0;
+    }
+    param = strchr(param, '&');
+    if (param != nullptr) {
+      param++;
+    }
+  }
+  return false;
+}
+
+void WebSocketRelay::resumeSession(uint8_t clientNum, const char* uuid, uint8_t previous) {
+  // The UUID is either still live on a stale connection (reload before the
+  // old socket timed out) or parked after a drop
+  uint8_t room;
+  if (previous != NO_CLIENT && previous != clientNum) {
+    room = clients.get(previous)->room;
+  } else {
+    ParkedSession session;
+    if (!sessions.reclaim(uuid, session)) {
+      return;
+    }
+    room = session.room;
+    previous = session.clientNum;
+    rooms[room].parkedSessions--;
+  }
+  
+  moveToRoom(clientNum, room);
+  LOG_INFO(LogModule::RELAY, "[WS] Client #%u resumed session of #%u in room '%s'",
+           clientNum, previous, rooms[room].name);
+           
+  JsonDocument doc;
+  doc["type"] = "relay_resumed";
+  doc["room"] = rooms[room].name;
+  doc["previousClientNum"] = previous;
+  
+  String message;
+  serializeJson(doc, message);
+  sendToClient(clientNum, (const uint8_t*)message.c_str(), message.length());
+  sendSnapshot(clientNum);
+  
+  // Others only need the new clientNum (for binary/targeted sends)
+  doc.clear();
+  doc["type"] = "player_reconnected";
+  doc["uuid"] = uuid;
+  doc["clientNum"] = clientNum;
+  doc["previousClientNum"] = previous;
+  
+  message = "";
+  serializeJson(doc, message);
+  sendToRoom(room, clientNum, (const uint8_t*)message.c_str(), message.length());
+}
+
+void WebSocketRelay::expireSessions() {
+  ParkedSession session;
+  while (sessions.expire(millis(), session)) {
+    LOG_INFO(LogModule::RELAY, "[WS] Session %s expired", session.uuid);
+    rooms[session.room].parkedSessions--;
+    announceDisconnect(session.room, session.uuid, NO_CLIENT);
+    releaseRoomIfEmpty(session.room);
+  }
+}
+
+void WebSocketRelay::announceDisconnect(uint8_t room, const char* uuid, uint8_t exceptClient) {
+  if (!rooms[room].inUse) {
+    return;
+  }
+  
+  JsonDocument doc;
+  doc["type"] = "player_disconnected";
+  doc["uuid"] = uuid;
+  doc["timestamp"] = millis();
+  
+  String message;
+  serializeJson(doc, message);
+  sendToRoom(room, exceptClient, (const uint8_t*)message.c_str(), message.length());
+}
+
+void WebSocketRelay::sendToRoom(uint8_t room, uint8_t exceptClient, const uint8_t* payload, size_t length) {
+  uint32_t targets = rooms[room].members;
+  if (exceptClient < WEBSOCKETS_SERVER_CLIENT_MAX) {
+    targets &= ~(1UL << exceptClient);
+  }
+  
+  // Large broadcasts are compressed once and the same frame goes to every
+  // client that asked for it. Clients with queued or batched text still get
+  // text, so nothing overtakes what is already waiting for them.
+  uint32_t compressed = 0;
+  if (deflateThreshold > 0 && length >= deflateThreshold) {
+    uint32_t candidates = targets & deflateClients;
+    while (candidates) {
+      uint8_t num = __builtin_ctz(candidates);
+      candidates &= candidates - 1;
+      if (batchInterval == 0 && outboxes[num].queue.isEmpty() && !isBlocked(num)) {
+        compressed |= (1UL << num);
+      }
+    }
+  }
+  
+  size_t frameLength = compressed ? deflateFrame(exceptClient, payload, length) : 0;
+  if (frameLength > 0) {
+    targets &= ~compressed;
+    while (compressed) {
+      uint8_t num = __builtin_ctz(compressed);
+      compressed &= compressed - 1;
+      sendBinaryToClient(num, deflateBuffer, frameLength);
+    }
+  }
+  
+  sendToMask(targets, payload, length);
+}
+
+size_t WebSocketRelay::deflateFrame(uint8_t source, const uint8_t* payload, size_t length) {
+  if (deflateBuffer == nullptr || length <= BINARY_HEADER_SIZE) {
+    return 0;
+  }
+  
+  unsigned long started = micros();
+  
+  // Only worth sending if the whole frame comes out smaller than the text
+  size_t limit = length - BINARY_HEADER_SIZE - 1;
+  if (limit > deflateBufferSize - BINARY_HEADER_SIZE) {
+    limit = deflateBufferSize - BINARY_HEADER_SIZE;
+  }
+  size_t body = deflater.compress(payload, length, deflateBuffer + BINARY_HEADER_SIZE, limit);
+  stats.deflateMicros += micros() - started;
+  
+  if (body == 0) {
+    stats.deflateSkipped++;
+    return 0;
+  }
+  
+  memset(deflateBuffer, 0, BINARY_HEADER_SIZE);
+  deflateBuffer[0] = BINARY_VERSION;
+  deflateBuffer[2] = BINARY_FLAG_DEFLATE;
+  deflateBuffer[4] = source;
+  
+  stats.deflatedMessages++;
+  stats.deflateBytesIn += length;
+  stats.deflateBytesOut += body + BINARY_HEADER_SIZE;
+  return body + BINARY_HEADER_SIZE;
+}
+
+void WebSocketRelay::storeSnapshot(uint8_t room, uint8_t owner, const uint8_t* payload, size_t length) {
+  Room& target = rooms[room];
+  target.snapshotOwner = owner;
+  
+  // An oversized snapshot can't be cached, and the previous one is now stale
+  if (length > snapshotLimit) {
+    target.snapshotLength = 0;
+    return;
+  }
+  
+  if (target.snapshot == nullptr) {
+    target.snapshot = (uint8_t*)malloc(snapshotLimit);
+    if (target.snapshot == nullptr) {
+      return;
+    }
+  }
+  
+  memcpy(target.snapshot, payload, length);
+  target.snapshotLength = length;
+}
+
+void WebSocketRelay::sendSnapshot(uint8_t clientNum) {
+  const Room& room = rooms[clients.get(clientNum)->room];
+  
+  // In delta mode the keyframe comes from the state the deltas were built
+  // against, so its version always matches what the room has been sent
+  if (deltaEnabled) {
+    if (room.state == nullptr || room.state->isNull()) {
+      return;
+    }
+    String state;
+    serializeJson(*room.state, state);
+    String keyframe = buildKeyframe(room.stateVersion, (const uint8_t*)state.c_str(), state.length());
+    sendToClient(clientNum, (const uint8_t*)keyframe.c_str(), keyframe.length());
+    return;
+  }
+  
+  if (room.snapshotLength > 0) {
+    sendToClient(clientNum, room.snapshot, room.snapshotLength);
+  }
+}
+
+void WebSocketRelay::relayState(uint8_t room, uint8_t sender, const uint8_t* payload, size_t length) {
+  Room& target = rooms[room];
+  unsigned long started = micros();
+  
+  if (target.state == nullptr) {
+    target.state = new JsonDocument();
+  }
+  
+  // Too big to keep: relay it as is and start over with a keyframe next
+  // time, so nobody is sent deltas against a state they never had
+  if (length > snapshotLimit) {
+    target.state->clear();
+    sendToRoom(room, sender, payload, length);
+    return;
+  }
+  
+  // Anything we can't diff is relayed untouched. It isn't part of the
+  // versioned state, so it isn't kept for late joiners either.
+  JsonDocument current;
+  if (deserializeJson(current, payload, length) || !current.is<JsonObject>()) {
+    sendToRoom(room, sender, payload, length);
+    return;
+  }
+  
+  target.stateVersion++;
+  bool keyframe = target.state->isNull() || target.stateVersion % keyframeInterval == 0;
+  
+  // { "type": "relay_delta", "v": 8, "base": 7, "patch": { ... } }
+  // The patch is computed once and the same bytes go to every player.
+  String message;
+  if (!keyframe) {
+    JsonDocument delta;
+    delta["type"] = "relay_delta";
+    delta["v"] = target.stateVersion;
+    delta["base"] = (uint16_t)(target.stateVersion - 1);
+    diffState(target.state->as<JsonObjectConst>(), current.as<JsonObjectConst>(),
+              delta["patch"].to<JsonObject>());
+    serializeJson(delta, message);
+    
+    // Not worth it when most of the state changed
+    keyframe = message.length() >= length;
+  }
+  
+  if (keyframe) {
+    message = buildKeyframe(target.stateVersion, payload, length);
+  }
+  
+  *target.state = std::move(current);
+  
+  stats.deltaUpdates++;
+  stats.deltaFullBytes += length;
+  stats.deltaSentBytes += message.length();
+  stats.deltaMicros += micros() - started;
+  
+  sendToRoom(room, sender, (const uint8_t*)message.c_str(), message.length());
+}
+
+// JSON Merge Patch (RFC 7386): changed values are included, nested objects
+// recurse, removed keys become null. Arrays are replaced whole. Null values
+// in the state itself are treated as absent (merge patch can't express them).
+void WebSocketRelay::diffState(JsonObjectConst previous, JsonObjectConst current, JsonObject patch) {
+  for (JsonPairConst entry : current) {
+    JsonVariantConst before = previous[entry.key()];
+    JsonVariantConst after = entry.value();
+    
+    if (after.isNull()) {
+      continue;
+    }
+    
+    if (before.is<JsonObjectConst>() && after.is<JsonObjectConst>()) {
+      JsonObject nested = patch[entry.key()].to<JsonObject>();
+      diffState(before.as<JsonObjectConst>(), after.as<JsonObjectConst>(), nested);
+      if (nested.size() == 0) {
+        patch.remove(entry.key());
+      }
+    } else if (before != after) {
+      patch[entry.key()] = after;
+    }
+  }
+  
+  for (JsonPairConst entry : previous) {
+    if (!entry.value().isNull() && current[entry.key()].isNull()) {
+      patch[entry.key()] = nullptr;
+    }
+  }
+}
+
+// { "type": "relay_keyframe", "v": 8, "state": <host's message, verbatim> }
+String WebSocketRelay::buildKeyframe(uint16_t version, const uint8_t* payload, size_t length) {
+  String keyframe;
+  keyframe.reserve(length + 48);
+  keyframe += "{\"type\":\"relay_keyframe\",\"v\":";
+  keyframe += version;
+  keyframe += ",\"state\":";
+  keyframe.concat((const char*)payload, length);
+  keyframe += "}";
+  return keyframe;
+}
+
+void WebSocketRelay::sendToMask(uint32_t targets, const uint8_t* payload, size_t length) {
+  // Walk only the set bits, so fan-out is O(recipients) not O(all clients)
+  while (targets) {
+    uint8_t num = __builtin_ctz(targets);
+    targets &= targets - 1;
+    sendToClient(num, payload, length);
+  }
+}
+
+uint32_t WebSocketRelay::resolveTarget(const JsonSpan& uuid, uint8_t room) {
+  char key[UUID_MAX_LENGTH + 1];
+  if (!JsonScanner::copyString(uuid, key, sizeof(key))) {
+    return 0;
+  }
+  
+  uint8_t num = clients.findUuid(key);
+  if (num == NO_CLIENT) {
+    return 0;
+  }
+  
+  uint32_t bit = 1UL << num;
+  return (rooms[room].members & bit) ? bit : 0;
+}
+
+uint32_t WebSocketRelay::resolveTargets(const JsonSpan& to, uint8_t room) {
+  // "to": "uuid"
+  if (to.isString()) {
+    return resolveTarget(to, room);
+  }
+  
+  // "to": ["uuid1", "uuid2", ...]
+  uint32_t targets = 0;
+  size_t cursor = 0;
+  JsonSpan element;
+  while (JsonScanner::nextElement(to, cursor, element)) {
+    targets |= resolveTarget(element, room);
+  }
+  return targets;
+}
+
+void WebSocketRelay::relayBinary(uint8_t clientNum, uint8_t* payload, size_t length) {
+  PlayerClient* client = clients.get(clientNum);
+  if (client == nullptr) {
+    return;
+  }
+  
+  if (length < BINARY_HEADER_SIZE || payload[0] != BINARY_VERSION) {
+    LOG_WARN(LogModule::RELAY, "[WS] Client #%u sent malformed binary frame (%u bytes) - ignored",
+             clientNum, (unsigned)length);
+    return;
+  }
+  
+  client->lastSeen = millis();
+  stats.messagesIn++;
+  stats.bytesIn += length;
+  
+  if (!admit(clientNum, client->room, length)) {
+    return;
+  }
+  
+  // Stamp the sender so receivers can reply to it with a targeted frame,
+  // and clear the flag receivers would try to inflate - only the relay sets it
+  payload[4] = clientNum;
+  payload[2] &= ~BINARY_FLAG_DEFLATE;
+  
+  uint32_t targets = rooms[client->room].members & ~(1UL << clientNum);
+  if (payload[2] & BINARY_FLAG_TARGETED) {
+    uint8_t target = payload[3];
+    targets = (target < WEBSOCKETS_SERVER_CLIENT_MAX) ? (targets & (1UL << target)) : 0;
+  }
+  
+  while (targets) {
+    uint8_t num = __builtin_ctz(targets);
+    targets &= targets - 1;
+    sendBinaryToClient(num, payload, length);
+  }
+}
+
+void WebSocketRelay::sendToClient(uint8_t clientNum, const uint8_t* payload, size_t length) {
+  stats.messagesOut++;
+  
+  // Fast path: nothing waiting and the client is keeping up
+  if (batchInterval == 0 && outboxes[clientNum].queue.isEmpty() && !isBlocked(clientNum)) {
+    sendFrame(clientNum, payload, length);
+    return;
+  }
+  
+  enqueue(clientNum, payload, length);
+}
+
+void WebSocketRelay::sendBinaryToClient(uint8_t clientNum, const uint8_t* payload, size_t length) {
+  stats.messagesOut++;
+  
+  // Binary frames are real-time updates that go stale quickly, so a client
+  // that's falling behind just misses them rather than queueing them
+  if (isBlocked(clientNum)) {
+    stats.messagesDropped++;
+    return;
+  }
+  
+  // Binary frames can't join a JSON array batch. Send whatever text is
+  // already waiting first so the client still sees messages in order.
+  drainClient(clientNum);
+  
+  unsigned long started = millis();
+  bool sent = server.sendBIN(clientNum, (uint8_t*)payload, length);
+  noteSendTime(clientNum, started, sent);
+  stats.framesOut++;
+  stats.bytesOut += length;
+  Metrics::bytesOut.record(length);
+}
+
+void WebSocketRelay::enqueue(uint8_t clientNum, const uint8_t* payload, size_t length) {
+  OutboundQueue& queue = outboxes[clientNum].queue;
+  
+  // Too big to ever be queued: send it now if the client can take it
+  if (!queue.canHold(length)) {
+    drainClient(clientNum);
+    if (queue.isEmpty() && !isBlocked(clientNum)) {
+      sendFrame(clientNum, payload, length);
+    } else {
+      stats.messagesDropped++;
+    }
+    return;
+  }
+  
+  while (queue.count() >= queueMessageLimit || !queue.push(payload, length)) {
+    // A client that's keeping up just gets an early flush...
+    if (!isBlocked(clientNum)) {
+      drainClient(clientNum);
+      continue;
+    }
+    
+    // ...a slow one loses its oldest message. Hosts broadcast full state,
+    // so an older message is superseded by the newer one anyway.
+    dropOldest(clientNum);
+  }
+}
+
+void WebSocketRelay::sendFrame(uint8_t clientNum, const uint8_t* payload, size_t length) {
+  unsigned long started = millis();
+  bool sent = server.sendTXT(clientNum, (uint8_t*)payload, length);
+  noteSendTime(clientNum, started, sent);
+  stats.framesOut++;
+  stats.bytesOut += length;
+  Metrics::bytesOut.record(length);
+}
+
+void WebSocketRelay::noteSendTime(uint8_t clientNum, unsigned long started, bool sent) {
+  // sendTXT/sendBIN block until the socket accepts the data. One stall is
+  // unavoidable, but after that the client is parked so it can't raise
+  // latency for everyone else on every message.
+  if (!sent || millis() - started >= SLOW_SEND_MS) {
+    outboxes[clientNum].blockedUntil = millis() + SLOW_BACKOFF_MS;
+    stats.slowSends++;
+  }
+}
+
+bool WebSocketRelay::isBlocked(uint8_t clientNum) {
+  unsigned long until = outboxes[clientNum].blockedUntil;
+  return until != 0 && (long)(until - millis()) > 0;
+}
+
+void WebSocketRelay::dropOldest(uint8_t clientNum) {
+  ClientOutbox& outbox = outboxes[clientNum];
+  outbox.queue.pop();
+  stats.messagesDropped++;
+  
+  if (!outbox.overflowing) {
+    outbox.overflowing = true;
+    outbox.overflowSince = millis();
+  }
+}
+
+void WebSocketRelay::drainClient(uint8_t clientNum) {
+  ClientOutbox& outbox = outboxes[clientNum];
+  
+  if (batchInterval > 0) {
+    if (!isBlocked(clientNum)) {
+      flushBatch(clientNum);
+    }
+  } else {
+    const uint8_t* data;
+    size_t length;
+    while (!isBlocked(clientNum) && outbox.queue.front(data, length)) {
+      sendFrame(clientNum, data, length);
+      outbox.queue.pop();
+    }
+  }
+  
+  if (outbox.queue.isEmpty()) {
+    outbox.overflowing = false;
+  }
+}
+
+void WebSocketRelay::flushBatch(uint8_t clientNum) {
+  OutboundQueue& queue = outboxes[clientNum].queue;
+  const uint8_t* data;
+  size_t length;
+  
+  // A lone message goes out as-is
+  if (queue.count() == 1) {
+    queue.front(data, length);
+    sendFrame(clientNum, data, length);
+    queue.clear();
+    return;
+  }
+  
+  if (queue.isEmpty()) {
+    return;
+  }
+  
+  // Several messages are coalesced into one frame holding a JSON array.
+  // The array is never larger than the queue itself (each record's 2-byte
+  // length prefix covers its comma), so batchBuffer can't overflow.
+  size_t n = 0;
+  batchBuffer[n++] = '[';
+  while (queue.front(data, length)) {
+    if (n > 1) {
+      batchBuffer[n++] = ',';
+    }
+    memcpy(batchBuffer + n, data, length);
+    n += length;
+    queue.pop();
+  }
+  batchBuffer[n++] = ']';
+  
+  sendFrame(clientNum, batchBuffer, n);
+}
+
+bool WebSocketRelay::start(const SystemConfig& config, uint16_t port) {
   Serial.println("\n--- Starting WebSocket Server ---");
   
+  // Queues are allocated once up front so the relay never allocates per message
+  size_t queueBytes = config.relayQueueBytes;
+  bool allocated = true;
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX && allocated; i++) {
+    allocated = outboxes[i].queue.init(queueBytes);
+  }
+  queueMessageLimit = config.relayQueueMessages > 0 ? config.relayQueueMessages : 1;
+  slowClientTimeout = config.relaySlowClientTimeout > 0 ? config.relaySlowClientTimeout : 0;
+  
+  if (allocated) {
+    Serial.printf("Outbound queues: %u bytes, %u messages/client\n",
+                  (unsigned)queueBytes, (unsigned)queueMessageLimit);
+  } else {
+    Serial.println("Not enough memory for outbound queues - slow clients will drop messages");
+  }
+  
+  if (config.relayBatchInterval > 0 && allocated) {
+    batchBuffer = (uint8_t*)malloc(queueBytes);
+    if (batchBuffer != nullptr) {
+      batchInterval = config.relayBatchInterval;
+      Serial.printf("Message batching: every %lu ms\n", batchInterval);
+    } else {
+      Serial.println("Not enough memory for batching - sending immediately");
+    }
+  }
+  
+  snapshotLimit = config.relaySnapshotBytes > 0 ? config.relaySnapshotBytes : 0;
+  
+  // Compression context (~10 KB) and one output buffer, shared by all rooms
+  if (config.relayDeflateThreshold > 0 && deflater.init()) {
+    deflateBufferSize = queueBytes > snapshotLimit ? queueBytes : snapshotLimit;
+    deflateBuffer = (uint8_t*)malloc(deflateBufferSize);
+    if (deflateBuffer != nullptr) {
+      deflateThreshold = config.relayDeflateThreshold;
+      Serial.printf("Compression: messages over %u bytes (clients with ?deflate=1)\n",
+                    (unsigned)deflateThreshold);
+    } else {
+      Serial.println("Not enough memory for compression - sending uncompressed");
+    }
+  }
+  
+  // Delta mode replays keyframes from the snapshot cache, so it needs one
+  deltaEnabled = config.relayDeltaState && snapshotLimit > 0;
+  keyframeInterval = config.relayKeyframeInterval > 0 ? config.relayKeyframeInterval : 1;
+  if (deltaEnabled) {
+    Serial.printf("Delta state: on (keyframe every %u snapshots)\n", keyframeInterval);
+  }
+  
+  // Ping after idlePingAfter of silence, disconnect after idleTimeout
+  idleTimeout = config.relayIdleTimeout > 0 ? config.relayIdleTimeout : 0;
+  idlePingAfter = config.relayIdlePing > 0 ? config.relayIdlePing : idleTimeout / 2;
+  if (idlePingAfter >= idleTimeout) {
+    idlePingAfter = idleTimeout / 2;
+  }
+  idleTimers.init(IDLE_TICK_MS, millis());
+  if (idleTimeout > 0) {
+    Serial.printf("Idle clients: ping after %lu ms, drop after %lu ms\n", idlePingAfter, idleTimeout);
+  }
+  
+  defaultMessageRate = config.relayRateMessages > 0 ? config.relayRateMessages : 0;
+  defaultByteRate = config.relayRateBytes > 0 ? config.relayRateBytes : 0;
+  throttleNotices = config.relayThrottleNotice;
+  Serial.printf("Rate limit per client: %lu msg/s, %lu bytes/s (0 = unlimited)\n",
+                (unsigned long)defaultMessageRate, (unsigned long)defaultByteRate);
+                
+  defaultGracePeriod = config.relayReconnectGrace > 0 ? config.relayReconnectGrace * 1000UL : 0;
+  Serial.printf("Reconnect grace period: %lu s\n", defaultGracePeriod / 1000);
+  
+  // Default room always exists
+  rooms[0].inUse = true;
+  rooms[0].name[0] = '\0';
+  rooms[0].members = 0;
+  rooms[0].snapshotLength = 0;
+  rooms[0].game[0] = '\0';
+  rooms[0].gracePeriod = defaultGracePeriod;
+  rooms[0].parkedSessions = 0;
+  rooms[0].messageRate = defaultMessageRate;
+  rooms[0].byteRate = defaultByteRate;
+  
   server.begin();
   server.onEvent(onEvent);
   
@@ -127,17 +1236,112 @@ bool WebSocketRelay::start(uint16_t port) {
 
 void WebSocketRelay::process() {
   server.loop();
+  
+  unsigned long now = millis();
+  bool tick = batchInterval > 0 && now - lastFlush >= batchInterval;
+  if (tick) {
+    lastFlush = now;
+  }
+  
+  // Drain queues of clients that have caught up, and collect the ones that
+  // have been over their cap for too long. Disconnecting fires
+  // WStype_DISCONNECTED, which edits `clients`, so that happens afterwards.
+  uint32_t evict = 0;
+  uint32_t connected = clients.getConnectedMask();
+  while (connected) {
+    uint8_t num = __builtin_ctz(connected);
+    connected &= connected - 1;
+    ClientOutbox& outbox = outboxes[num];
+    
+    if (outbox.overflowing && slowClientTimeout > 0 && now - outbox.overflowSince > slowClientTimeout) {
+      evict |= (1UL << num);
+      continue;
+    }
+    
+    if (!outbox.queue.isEmpty() && (batchInterval == 0 || tick)) {
+      drainClient(num);
+    }
+    
+    if (limits[num].pendingSnapshot) {
+      flushCoalesced(num);
+    }
+  }
+  
+  while (evict) {
+    uint8_t num = __builtin_ctz(evict);
+    evict &= evict - 1;
+    LOG_WARN(LogModule::RELAY, "[WS] Client #%u can't keep up - disconnecting", num);
+    stats.slowClientsDropped++;
+    server.disconnect(num);
+  }
+  
+  // Only clients whose idle timer came due are looked at
+  uint32_t idle = idleTimeout > 0 ? checkIdle(idleTimers.advance(now), now) : 0;
+  while (idle) {
+    uint8_t num = __builtin_ctz(idle);
+    idle &= idle - 1;
+    LOG_INFO(LogModule::RELAY, "[WS] Client #%u silent for %lu ms - disconnecting", num, idleTimeout);
+    stats.idleClientsDropped++;
+    server.disconnect(num);
+  }
+  
+  if (sessions.count() > 0 && now - lastSessionCheck >= SESSION_CHECK_MS) {
+    lastSessionCheck = now;
+    expireSessions();
+  }
+}
+
+uint32_t WebSocketRelay::checkIdle(uint32_t fired, unsigned long now) {
+  uint32_t evict = 0;
+  
+  while (fired) {
+    uint8_t num = __builtin_ctz(fired);
+    fired &= fired - 1;
+    
+    PlayerClient* client = clients.get(num);
+    if (client == nullptr) {
+      continue;
+    }
+    
+    // Traffic since the timer was set just pushes it back
+    unsigned long silent = now - client->lastSeen;
+    if (silent >= idleTimeout) {
+      evict |= (1UL << num);
+    } else if (silent >= idlePingAfter) {
+      server.sendPing(num);
+      stats.idlePings++;
+      idleTimers.schedule(num, client->lastSeen + idleTimeout);
+    } else {
+      idleTimers.schedule(num, client->lastSeen + idlePingAfter);
+    }
+  }
+  return evict;
 }
 
 int WebSocketRelay::getClientCount() {
-  return clients.size();
+  return clients.count();
+}
+
+void WebSocketRelay::broadcastMessage(const String& message, const String& room) {
+  int index = findRoom(room.c_str());
+  if (index < 0) {
+    return;
+  }
+  
+  sendToRoom(index, NO_CLIENT, (const uint8_t*)message.c_str(), message.length());
 }
 
-void WebSocketRelay::broadcastMessage(const String& message) {
-  String msg = message; // Create mutable copy for WebSocket library
-  for (auto& client : clients) {
-    server.sendTXT(client.first, msg);
+const RelayStats& WebSocketRelay::getStats() {
+  stats.queuedMessages = 0;
+  stats.queuedBytes = 0;
+  uint32_t connected = clients.getConnectedMask();
+  while (connected) {
+    uint8_t num = __builtin_ctz(connected);
+    connected &= connected - 1;
+    stats.queuedMessages += outboxes[num].queue.count();
+    stats.queuedBytes += outboxes[num].queue.bytes();
   }
+  return stats;
 }
 
 void WebSocketRelay::stop() {
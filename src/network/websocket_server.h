@@ -3,17 +3,110 @@
 
 #include <WebSocketsServer.h>
 #include <ArduinoJson.h>
-#include <map>
+#include "client_registry.h"
+#include "json_scanner.h"
+#include "outbound_queue.h"
+#include "session_table.h"
+#include "storage/config.h"
+#include "storage/game_catalog.h"
+#include "utils/timer_wheel.h"
+#include "utils/token_bucket.h"
+#include "utils/deflate.h"
 
-struct PlayerClient {
-  String uuid;
-  unsigned long lastSeen;
+// Rooms partition the relay so separate tables don't pay for each other's traffic.
+// Room 0 is the default (unnamed) room every client starts in.
+static const uint8_t MAX_ROOMS = 8;
+static const size_t ROOM_NAME_MAX_LENGTH = 31;
+
+// Binary frames carry a fixed 8-byte header the relay routes on without any
+// JSON handling:
+//   [0] version   [1] message type (game-defined)   [2] flags (see below)
+//   [3] target clientNum (when BINARY_FLAG_TARGETED)
+//   [4] source clientNum (filled in by the relay)   [5] reserved
+//   [6..7] sequence number, little-endian (game-defined, passed through)
+static const size_t BINARY_HEADER_SIZE = 8;
+static const uint8_t BINARY_VERSION = 1;
+static const uint8_t BINARY_FLAG_TARGETED = 0x01;
+
+// Set by the relay only: the body is a raw-deflated JSON text message, sent to
+// clients that connected with ?deflate=1 in place of the text frame
+static const uint8_t BINARY_FLAG_DEFLATE = 0x02;
+
+struct Room {
+  bool inUse;
+  char name[ROOM_NAME_MAX_LENGTH + 1];
+  uint32_t members;
+  
+  // Game whose manifest set the rules below ("" = none yet, config defaults)
+  char game[GAME_FOLDER_MAX_LENGTH + 1];
+  
+  // How long a dropped player's place is held (from the room's game manifest)
+  unsigned long gracePeriod;
+  uint8_t parkedSessions;   // Dropped players who may still come back
+  
+  // Inbound limits for each player in the room (0 = unlimited)
+  uint32_t messageRate;     // Messages per second
+  uint32_t byteRate;        // Bytes per second
+  
+  // Last message tagged "snapshot": true, replayed to players who join late.
+  // The buffer is allocated on first use and kept for the slot's lifetime.
+  uint8_t* snapshot;
+  size_t snapshotLength;
+  uint8_t snapshotOwner;    // Client that sent it
+  
+  // Delta mode: previous snapshot, parsed, to diff the next one against
+  JsonDocument* state;
+  uint16_t stateVersion;
+};
+
+// Running totals since boot (sample twice to get rates)
+struct RelayStats {
+  uint32_t messagesIn;    // Text and binary frames received from clients
+  uint32_t bytesIn;
+  uint32_t messagesOut;   // Individual message deliveries
+  uint32_t framesOut;     // WebSocket frames actually written (< messagesOut when batching)
+  uint32_t bytesOut;
+  uint32_t messagesDropped;    // Dropped because a client's queue was full
+  uint32_t slowSends;          // Sends that stalled the loop
+  uint32_t slowClientsDropped; // Clients disconnected for falling too far behind
+  uint32_t idlePings;          // Pings sent to clients that went quiet
+  uint32_t idleClientsDropped; // Clients disconnected for not answering
+  uint32_t messagesThrottled;  // Dropped for exceeding the sender's rate limit
+  uint32_t snapshotsCoalesced; // ...of which snapshots held back for a later send
+  uint32_t deflatedMessages;   // Broadcasts compressed (once each, however many recipients)
+  uint32_t deflateBytesIn;     // ...their original size
+  uint32_t deflateBytesOut;    // ...and compressed size, header included
+  uint32_t deflateMicros;      // Time spent compressing
+  uint32_t deflateSkipped;     // Over the threshold but didn't get smaller
+  uint32_t queuedMessages;     // Currently waiting in outbound queues
+  uint32_t queuedBytes;
+  uint32_t deltaUpdates;       // Snapshots handled in delta mode
+  uint32_t deltaFullBytes;     // ...their size as sent by the host
+  uint32_t deltaSentBytes;     // ...and the size of what the relay sent instead
+  uint32_t deltaMicros;        // Time spent parsing and diffing
+};
+
+// Inbound rate limiting for one client slot
+struct ClientLimits {
+  TokenBucket messages;
+  TokenBucket bytes;
+  uint32_t throttled;          // Dropped since the last relay_throttled notice
+  unsigned long lastNotice;
+  bool pendingSnapshot;        // A throttled snapshot is waiting in the room cache
+};
+
+// Outbound state for one client slot
+struct ClientOutbox {
+  OutboundQueue queue;
+  unsigned long blockedUntil;   // Last send stalled: hold messages until then
+  bool overflowing;             // Queue has been dropping messages...
+  unsigned long overflowSince;  // ...since this time
 };
 
 class WebSocketRelay {
 public:
   // Start WebSocket server
-  static bool start(uint16_t port = 81);
+  static bool start(const SystemConfig& config, uint16_t port = 81);
   
   // Process WebSocket events (call in loop)
   static void process();
@@ -21,18 +114,128 @@ public:
   // Get number of connected clients
   static int getClientCount();
   
-  // Broadcast message to all clients
-  static void broadcastMessage(const String& message);
+  // Broadcast message to all clients in a room ("" = default room)
+  static void broadcastMessage(const String& message, const String& room = "");
+  
+  // Get relay traffic counters
+  static const RelayStats& getStats();
   
   // Stop WebSocket server
   static void stop();
 
 private:
   static WebSocketsServer server;
-  static std::map<uint8_t, PlayerClient> clients;
+  static ClientRegistry clients;
+  static SessionTable sessions;
+  static Room rooms[MAX_ROOMS];
+  static RelayStats stats;
+  
+  // Outbound queues: hold messages while a client is slow, or for one tick
+  // when batching is enabled
+  static ClientOutbox outboxes[WEBSOCKETS_SERVER_CLIENT_MAX];
+  static ClientLimits limits[WEBSOCKETS_SERVER_CLIENT_MAX];
+  static uint32_t defaultMessageRate;
+  static uint32_t defaultByteRate;
+  static bool throttleNotices;
+  
+  // Clock service: receive time of the message being handled (µs since
+  // boot, 64-bit so it never wraps), and scratch space for stamping it in
+  static uint64_t receivedAt;
+  static uint8_t* stampBuffer;
+  static size_t stampBufferSize;
+  
+  // Compressed broadcasts: one shared encoder context and output buffer
+  static DeflateEncoder deflater;
+  static uint8_t* deflateBuffer;
+  static size_t deflateBufferSize;
+  static size_t deflateThreshold;
+  static uint32_t deflateClients;   // Clients that asked for compressed frames
+  static uint8_t* batchBuffer;
+  static unsigned long batchInterval;
+  static unsigned long lastFlush;
+  static size_t queueMessageLimit;
+  static unsigned long slowClientTimeout;
+  static size_t snapshotLimit;
+  static bool deltaEnabled;
+  static uint16_t keyframeInterval;
+  static unsigned long defaultGracePeriod;
+  static unsigned long lastSessionCheck;
+  
+  // Idle detection: one timer per client, re-armed lazily from lastSeen so
+  // the message path never touches the wheel
+  static TimerWheel idleTimers;
+  static unsigned long idlePingAfter;
+  static unsigned long idleTimeout;
   
   // Event handler
   static void onEvent(uint8_t clientNum, WStype_t type, uint8_t* payload, size_t length);
+  
+  // Relay a text message from a client (JSON envelope routing)
+  static void relayText(uint8_t clientNum, uint8_t* payload, size_t length);
+  
+  // Relay control messages ("relay_*" types) are handled here, never relayed
+  static void handleControlMessage(uint8_t clientNum, const JsonSpan& type,
+                                   const uint8_t* payload, size_t length);
+                                   
+  // Room helpers
+  static int findRoom(const char* name);
+  static int acquireRoom(const char* name);
+  static bool joinRoom(uint8_t clientNum, const char* name);
+  static void moveToRoom(uint8_t clientNum, uint8_t room);
+  static void leaveRoom(uint8_t clientNum);
+  static void releaseRoomIfEmpty(uint8_t room);
+  static void setRoomGame(uint8_t room, const char* folder);
+  static bool parseQueryParam(const char* url, const char* name, char* out, size_t outSize);
+  static void sendToRoom(uint8_t room, uint8_t exceptClient, const uint8_t* payload, size_t length);
+  
+  // Reconnect grace period: dropped players are parked, not announced
+  static void resumeSession(uint8_t clientNum, const char* uuid, uint8_t previous);
+  static void expireSessions();
+  static void announceDisconnect(uint8_t room, const char* uuid, uint8_t exceptClient);
+  
+  // Clock service: answer relay_ping, add "serverTime" to stamped messages
+  static void sendPong(uint8_t clientNum, const uint8_t* payload, size_t length);
+  static size_t stampMessage(const uint8_t* payload, size_t length);
+  
+  // Compress a text message into a BINARY_FLAG_DEFLATE frame in deflateBuffer
+  static size_t deflateFrame(uint8_t source, const uint8_t* payload, size_t length);
+  
+  // Rate limiting: spend the sender's budget before any fan-out
+  static bool spendBudget(uint8_t clientNum, uint8_t room, size_t length);
+  static bool admit(uint8_t clientNum, uint8_t room, size_t length);
+  static void flushCoalesced(uint8_t clientNum);
+  
+  // Ping quiet clients, and collect the ones that stayed silent too long
+  static uint32_t checkIdle(uint32_t fired, unsigned long now);
+  
+  // Late-joiner state cache
+  static void storeSnapshot(uint8_t room, uint8_t owner, const uint8_t* payload, size_t length);
+  static void sendSnapshot(uint8_t clientNum);
+  
+  // Delta mode: relay a snapshot as a merge patch against the previous one
+  static void relayState(uint8_t room, uint8_t sender, const uint8_t* payload, size_t length);
+  static void diffState(JsonObjectConst previous, JsonObjectConst current, JsonObject patch);
+  static String buildKeyframe(uint16_t version, const uint8_t* payload, size_t length);
+  
+  // Targeted delivery: resolve a "to" field (UUID or list of UUIDs) to a
+  // clientNum bitmask, restricted to the given room
+  static uint32_t resolveTargets(const JsonSpan& to, uint8_t room);
+  static uint32_t resolveTarget(const JsonSpan& uuid, uint8_t room);
+  static void sendToMask(uint32_t targets, const uint8_t* payload, size_t length);
+  
+  // Binary relay (routes on the fixed header only)
+  static void relayBinary(uint8_t clientNum, uint8_t* payload, size_t length);
+  
+  // Outbound path
+  static void sendToClient(uint8_t clientNum, const uint8_t* payload, size_t length);
+  static void sendBinaryToClient(uint8_t clientNum, const uint8_t* payload, size_t length);
+  static void enqueue(uint8_t clientNum, const uint8_t* payload, size_t length);
+  static void sendFrame(uint8_t clientNum, const uint8_t* payload, size_t length);
+  static void drainClient(uint8_t clientNum);
+  static void flushBatch(uint8_t clientNum);
+  static void dropOldest(uint8_t clientNum);
+  static bool isBlocked(uint8_t clientNum);
+  static void noteSendTime(uint8_t clientNum, unsigned long started, bool sent);
 };
 
 #endif
@@ -0,0 +1,206 @@
+#include "cartridge.h"
+#include "sd_card.h"
+#include "utils/logger.h"
+
+Cartridge CartridgeStore::cartridges[CartridgeStore::MAX_OPEN];
+uint32_t CartridgeStore::useCounter = 0;
+uint32_t CartridgeStore::generation = 0;
+
+const CartridgeEntry* Cartridge::find(const String& assetPath) const {
+  uint32_t h = CartridgeStore::hash(assetPath.c_str());
+  
+  // First entry with this hash
+  uint16_t low = 0;
+  uint16_t high = entryCount;
+  while (low < high) {
+    uint16_t mid = (low + high) / 2;
+    if (entries[mid].pathHash < h) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  
+  // A path that isn't in the pack can share a hash with one that is; the
+  // second hash tells them apart
+  uint32_t c = CartridgeStore::check(assetPath.c_str());
+  for (uint16_t i = low; i < entryCount && entries[i].pathHash == h; i++) {
+    if (entries[i].pathCheck == c) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+const Cartridge* CartridgeStore::open(const char* folder) {
+  if (generation != SDCard::getGeneration()) {
+    clear();
+    generation = SDCard::getGeneration();
+  }
+  
+  Cartridge* slot = &cartridges[0];
+  for (uint8_t i = 0; i < MAX_OPEN; i++) {
+    Cartridge& cartridge = cartridges[i];
+    if (cartridge.entries != nullptr && strcmp(cartridge.folder, folder) == 0) {
+      cartridge.lastUsed = ++useCounter;
+      return &cartridge;
+    }
+    
+    // Otherwise load into a free slot, or the least recently used one
+    if (slot->entries != nullptr &&
+        (cartridge.entries == nullptr || cartridge.lastUsed < slot->lastUsed)) {
+      slot = &cartridge;
+    }
+  }
+  
+  unload(*slot);
+  if (!load(folder, *slot)) {
+    return nullptr;
+  }
+  slot->lastUsed = ++useCounter;
+  return slot;
+}
+
+const Cartridge* CartridgeStore::forPath(const String& path, String& assetPath) {
+  if (!path.startsWith("/games/")) {
+    return nullptr;
+  }
+  int slash = path.indexOf('/', 7);
+  if (slash <= 7) {
+    return nullptr;
+  }
+  
+  // The catalog knows which games are packed, so loose folders cost nothing here
+  String folder = path.substring(7, slash);
+  const GameManifest* manifest = GameCatalog::find(folder.c_str());
+  if (manifest == nullptr || !manifest->packed) {
+    return nullptr;
+  }
+  
+  const Cartridge* cartridge = open(manifest->folder);
+  if (cartridge != nullptr) {
+    assetPath = path.substring(slash);
+  }
+  return cartridge;
+}
+
+void CartridgeStore::clear() {
+  for (uint8_t i = 0; i < MAX_OPEN; i++) {
+    unload(cartridges[i]);
+  }
+}
+
+static int compareEntries(const void* a, const void* b) {
+  const CartridgeEntry* ea = (const CartridgeEntry*)a;
+  const CartridgeEntry* eb = (const CartridgeEntry*)b;
+  if (ea->pathHash != eb->pathHash) {
+    return ea->pathHash < eb->pathHash ? -1 : 1;
+  }
+  return ea->pathCheck < eb->pathCheck ? -1 : (ea->pathCheck > eb->pathCheck ? 1 : 0);
+}
+
+bool CartridgeStore::seekTo(File& file, const char* assetPath, CartridgeEntry& entry) {
+  uint16_t count;
+  if (!file.seek(0) || !readHeader(file, count)) {
+    return false;
+  }
+  
+  uint32_t h = hash(assetPath);
+  uint32_t c = check(assetPath);
+  for (uint16_t i = 0; i < count; i++) {
+    if (file.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+      return false;
+    }
+    if (entry.pathHash == h && entry.pathCheck == c) {
+      return (uint64_t)entry.offset + entry.length <= file.size() && file.seek(entry.offset);
+    }
+  }
+  return false;
+}
+
+// Leaves the file positioned at the start of the index
+bool CartridgeStore::readHeader(File& file, uint16_t& count) {
+  uint8_t header[CARTRIDGE_HEADER_SIZE];
+  if (file.read(header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  
+  uint32_t magic;
+  uint16_t version;
+  memcpy(&magic, header, 4);
+  memcpy(&version, header + 4, 2);
+  memcpy(&count, header + 6, 2);
+  return magic == CARTRIDGE_MAGIC && version == CARTRIDGE_VERSION && count <= MAX_ENTRIES;
+}
+
+bool CartridgeStore::load(const char* folder, Cartridge& cartridge) {
+  snprintf(cartridge.path, sizeof(cartridge.path), "/games/%s.lpa", folder);
+  File file = SDCard::openFile(cartridge.path);
+  if (!file) {
+    return false;
+  }
+  
+  uint16_t count;
+  if (!readHeader(file, count)) {
+    LOG_WARN(LogModule::STORAGE, "[Cartridge] %s: not a version %u cartridge - repack it with tools/pack_cartridge.py",
+             cartridge.path, CARTRIDGE_VERSION);
+    file.close();
+    return false;
+  }
+  
+  size_t bytes = (size_t)count * sizeof(CartridgeEntry);
+  CartridgeEntry* entries = (CartridgeEntry*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+  if (entries == nullptr || file.read((uint8_t*)entries, bytes) != bytes) {
+    LOG_WARN(LogModule::STORAGE, "[Cartridge] %s: can't read index", cartridge.path);
+    free(entries);
+    file.close();
+    return false;
+  }
+  
+  cartridge.fileSize = file.size();
+  cartridge.lastWrite = file.getLastWrite();
+  file.close();
+  
+  // The packer writes them sorted; don't rely on it
+  qsort(entries, count, sizeof(CartridgeEntry), compareEntries);
+  
+  // Anything pointing past the end would make a response shorter than
+  // the Content-Length it promised
+  for (uint16_t i = 0; i < count; i++) {
+    if ((uint64_t)entries[i].offset + entries[i].length > cartridge.fileSize) {
+      LOG_WARN(LogModule::STORAGE, "[Cartridge] %s: index points past the end of the file", cartridge.path);
+      free(entries);
+      return false;
+    }
+  }
+  
+  strncpy(cartridge.folder, folder, GAME_FOLDER_MAX_LENGTH);
+  cartridge.folder[GAME_FOLDER_MAX_LENGTH] = '\0';
+  cartridge.entryCount = count;
+  cartridge.entries = entries;
+  LOG_INFO(LogModule::STORAGE, "[Cartridge] Opened %s (%u files)", cartridge.path, (unsigned)count);
+  return true;
+}
+
+void CartridgeStore::unload(Cartridge& cartridge) {
+  free(cartridge.entries);
+  cartridge.entries = nullptr;
+  cartridge.entryCount = 0;
+}
+
+uint32_t CartridgeStore::hash(const char* path) {
+  uint32_t h = 2166136261UL;
+  while (*path) {
+    h ^= (uint8_t)*path++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+uint32_t CartridgeStore::check(const char* path) {
+  uint32_t h = 5381;
+  while (*path) {
+    h = h * 33 + (uint8_t)*path++;
+  }
+  return h;
+}
@@ -0,0 +1,83 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <Arduino.h>
+#include "game_catalog.h"
+
+// Packed cartridge: a whole game folder in one /games/<folder>.lpa file,
+// built by tools/pack_cartridge.py. All fields little-endian.
+//
+//   header   "LPA1", uint16 version (2), uint16 entry count, 8 bytes reserved
+//   index    one CartridgeEntry per file, sorted by path hash then check
+//   data     each file starting on a 512-byte boundary, so reads are whole
+//            SD sectors
+//
+// Paths are relative to the folder with a leading slash ("/index.html").
+// A compressible file may also be stored gzipped under "<path>.gz".
+static const uint32_t CARTRIDGE_MAGIC = 0x3141504C;   // "LPA1"
+static const uint16_t CARTRIDGE_VERSION = 2;       // 1 had no pathCheck
+static const size_t CARTRIDGE_HEADER_SIZE = 16;
+static const uint8_t CARTRIDGE_FLAG_GZIP = 0x01;      // Data is gzip (send Content-Encoding)
+
+struct CartridgeEntry {
+  uint32_t pathHash;      // FNV-1a of the path
+  uint32_t pathCheck;     // djb2 of the path, to confirm a pathHash match
+  uint32_t offset;        // From the start of the .lpa
+  uint32_t length;
+  uint32_t contentHash;   // CRC-32 of the data, used as the ETag
+  uint8_t flags;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(CartridgeEntry) == 24, "CartridgeEntry must match the file layout");
+
+struct Cartridge {
+  char folder[GAME_FOLDER_MAX_LENGTH + 1];
+  char path[GAME_FOLDER_MAX_LENGTH + 12];   // "/games/<folder>.lpa"
+  time_t lastWrite;
+  uint32_t fileSize;
+  uint16_t entryCount;
+  CartridgeEntry* entries;                  // nullptr = slot unused
+  uint32_t lastUsed;
+  
+  // nullptr if the cartridge has no such file
+  const CartridgeEntry* find(const String& assetPath) const;
+};
+
+// Indexes of recently used cartridges, loaded from the card on first use
+// and dropped when it changes
+class CartridgeStore {
+public:
+  // Cartridge for a game folder, or nullptr if it isn't packed (or the
+  // .lpa is unreadable)
+  static const Cartridge* open(const char* folder);
+  
+  // For a URL under /games/<folder>/ of a packed game: its cartridge, with
+  // the rest of the path ("/index.html") written to assetPath
+  static const Cartridge* forPath(const String& path, String& assetPath);
+  
+  static void clear();
+  
+  // Seek an open .lpa to one of its files without loading the whole index
+  // (for reading a manifest at scan time). False if it isn't in there.
+  static bool seekTo(File& file, const char* assetPath, CartridgeEntry& entry);
+  
+  // FNV-1a, as used for both the index and the packer
+  static uint32_t hash(const char* path);
+  
+  // djb2: unrelated to FNV-1a, so two paths that share one hash won't
+  // share this one too
+  static uint32_t check(const char* path);
+
+private:
+  static const uint8_t MAX_OPEN = 4;
+  static const uint16_t MAX_ENTRIES = 1024;
+  static Cartridge cartridges[MAX_OPEN];
+  static uint32_t useCounter;
+  static uint32_t generation;   // SD card generation the indexes came from
+  
+  static bool readHeader(File& file, uint16_t& count);
+  static bool load(const char* folder, Cartridge& cartridge);
+  static void unload(Cartridge& cartridge);
+};
+
+#endif
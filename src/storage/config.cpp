@@ -53,6 +53,120 @@ bool ConfigManager::loadFromSD(const char* path, SystemConfig& config) {
     Serial.printf("  Header BMP: %s\n", config.headerBMP.c_str());
   }
   
+  if (doc["relayBatchInterval"].is<int>()) {
+    config.relayBatchInterval = doc["relayBatchInterval"];
+    Serial.printf("  Relay batch interval: %d ms\n", config.relayBatchInterval);
+  }
+  
+  if (doc["relayQueueBytes"].is<int>()) {
+    config.relayQueueBytes = doc["relayQueueBytes"];
+    Serial.printf("  Relay queue: %d bytes/client\n", config.relayQueueBytes);
+  }
+  
+  if (doc["relayQueueMessages"].is<int>()) {
+    config.relayQueueMessages = doc["relayQueueMessages"];
+    Serial.printf("  Relay queue: %d messages/client\n", config.relayQueueMessages);
+  }
+  
+  if (doc["relaySlowClientTimeout"].is<int>()) {
+    config.relaySlowClientTimeout = doc["relaySlowClientTimeout"];
+    Serial.printf("  Slow client timeout: %d ms\n", config.relaySlowClientTimeout);
+  }
+  
+  if (doc["relaySnapshotBytes"].is<int>()) {
+    config.relaySnapshotBytes = doc["relaySnapshotBytes"];
+    Serial.printf("  Snapshot cache: %d bytes/room\n", config.relaySnapshotBytes);
+  }
+  
+  if (doc["relayDeltaState"].is<bool>()) {
+    config.relayDeltaState = doc["relayDeltaState"];
+    Serial.printf("  Delta state: %s\n", config.relayDeltaState ? "on" : "off");
+  }
+  
+  if (doc["relayKeyframeInterval"].is<int>()) {
+    config.relayKeyframeInterval = doc["relayKeyframeInterval"];
+    Serial.printf("  Keyframe interval: %d\n", config.relayKeyframeInterval);
+  }
+  
+  if (doc["relayReconnectGrace"].is<int>()) {
+    config.relayReconnectGrace = doc["relayReconnectGrace"];
+    Serial.printf("  Reconnect grace: %d s\n", config.relayReconnectGrace);
+  }
+  
+  if (doc["relayIdlePing"].is<int>()) {
+    config.relayIdlePing = doc["relayIdlePing"];
+    Serial.printf("  Idle ping: %d ms\n", config.relayIdlePing);
+  }
+  
+  if (doc["relayIdleTimeout"].is<int>()) {
+    config.relayIdleTimeout = doc["relayIdleTimeout"];
+    Serial.printf("  Idle timeout: %d ms\n", config.relayIdleTimeout);
+  }
+  
+  if (doc["relayRateMessages"].is<int>()) {
+    config.relayRateMessages = doc["relayRateMessages"];
+    Serial.printf("  Rate limit: %d msg/s\n", config.relayRateMessages);
+  }
+  
+  if (doc["relayRateBytes"].is<int>()) {
+    config.relayRateBytes = doc["relayRateBytes"];
+    Serial.printf("  Rate limit: %d bytes/s\n", config.relayRateBytes);
+  }
+  
+  if (doc["relayThrottleNotice"].is<bool>()) {
+    config.relayThrottleNotice = doc["relayThrottleNotice"];
+    Serial.printf("  Throttle notices: %s\n", config.relayThrottleNotice ? "on" : "off");
+  }
+  
+  if (doc["relayDeflateThreshold"].is<int>()) {
+    config.relayDeflateThreshold = doc["relayDeflateThreshold"];
+    Serial.printf("  Deflate threshold: %d bytes\n", config.relayDeflateThreshold);
+  }
+  
+  if (doc["httpCacheBytes"].is<int>()) {
+    config.httpCacheBytes = doc["httpCacheBytes"];
+    Serial.printf("  File cache: %d bytes\n", config.httpCacheBytes);
+  }
+  
+  if (doc["httpCacheMaxFile"].is<int>()) {
+    config.httpCacheMaxFile = doc["httpCacheMaxFile"];
+    Serial.printf("  File cache max file: %d bytes\n", config.httpCacheMaxFile);
+  }
+  
+  if (doc["httpFileIndex"].is<bool>()) {
+    config.httpFileIndex = doc["httpFileIndex"];
+    Serial.printf("  File index: %s\n", config.httpFileIndex ? "on" : "off");
+  }
+  
+  if (doc["httpCacheControl"].is<String>()) {
+    config.httpCacheControl = doc["httpCacheControl"].as<String>();
+    Serial.printf("  Cache-Control: %s\n", config.httpCacheControl.c_str());
+  }
+  
+  // "logLevel" for every module, then "logLevels": { "http": "debug" } per module
+  if (doc["logLevel"].is<const char*>()) {
+    int level = Logger::parseLevel(doc["logLevel"]);
+    if (level >= 0) {
+      for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++) {
+        config.logLevels[i] = level;
+      }
+      Serial.printf("  Log level: %s\n", doc["logLevel"].as<const char*>());
+    }
+  }
+  
+  if (doc["logLevels"].is<JsonObject>()) {
+    for (JsonPair pair : doc["logLevels"].as<JsonObject>()) {
+      LogModule module = Logger::parseModule(pair.key().c_str());
+      int level = Logger::parseLevel(pair.value().as<const char*>());
+      if (module == LogModule::COUNT || level < 0) {
+        Serial.printf("  Log level for '%s' not understood - ignored\n", pair.key().c_str());
+        continue;
+      }
+      config.logLevels[(uint8_t)module] = level;
+      Serial.printf("  Log level (%s): %s\n", pair.key().c_str(), pair.value().as<const char*>());
+    }
+  }
+  
   return true;
 }
 
@@ -63,5 +177,22 @@ void ConfigManager::printConfig(const SystemConfig& config) {
   Serial.printf("  Hostname: %s\n", config.hostname.c_str());
   Serial.printf("  Header BMP: %s\n", config.headerBMP.c_str());
   Serial.printf("  Max Connections: %d\n", config.maxConnections);
+  Serial.printf("  Relay Batch Interval: %d ms\n", config.relayBatchInterval);
+  Serial.printf("  Relay Queue: %d bytes, %d messages/client\n",
+                config.relayQueueBytes, config.relayQueueMessages);
+  Serial.printf("  Slow Client Timeout: %d ms\n", config.relaySlowClientTimeout);
+  Serial.printf("  Snapshot Cache: %d bytes/room\n", config.relaySnapshotBytes);
+  Serial.printf("  Delta State: %s (keyframe every %d)\n",
+                config.relayDeltaState ? "on" : "off", config.relayKeyframeInterval);
+  Serial.printf("  Reconnect Grace: %d s\n", config.relayReconnectGrace);
+  Serial.printf("  Idle Ping/Timeout: %d / %d ms\n", config.relayIdlePing, config.relayIdleTimeout);
+  Serial.printf("  Rate Limit: %d msg/s, %d bytes/s\n", config.relayRateMessages, config.relayRateBytes);
+  Serial.printf("  Deflate Threshold: %d bytes\n", config.relayDeflateThreshold);
+  Serial.printf("  File Cache: %d bytes (files up to %d)\n", config.httpCacheBytes, config.httpCacheMaxFile);
+  Serial.printf("  File Index: %s\n", config.httpFileIndex ? "on" : "off");
+  Serial.printf("  Cache-Control: %s\n", config.httpCacheControl.c_str());
+  Serial.printf("  Log Levels: system %s, http %s, relay %s, storage %s\n",
+                Logger::levelName(config.logLevels[0]), Logger::levelName(config.logLevels[1]),
+                Logger::levelName(config.logLevels[2]), Logger::levelName(config.logLevels[3]));
   Serial.println("============================\n");
 }
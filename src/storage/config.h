@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "utils/logger.h"
 
 // System configuration structure
 struct SystemConfig {
@@ -10,6 +11,33 @@ struct SystemConfig {
   String hostname = "play";
   String headerBMP = "Header.bmp";
   int maxConnections = 20;
+  
+  // WebSocket relay
+  int relayBatchInterval = 0;         // ms between batched flushes (0 = send immediately)
+  int relayQueueBytes = 2048;         // Per-client outbound buffer size
+  int relayQueueMessages = 64;        // Per-client outbound message cap
+  int relaySlowClientTimeout = 5000;  // ms a client may stay over its cap (0 = never disconnect)
+  int relaySnapshotBytes = 4096;      // Max cached state snapshot per room (0 = off)
+  bool relayDeltaState = false;       // Send snapshots as JSON merge patches
+  int relayKeyframeInterval = 30;     // Full state every N snapshots in delta mode
+  int relayReconnectGrace = 300;      // Seconds a dropped player's place is held (0 = off)
+  int relayIdlePing = 15000;          // Ping a client after this much silence (ms)
+  int relayIdleTimeout = 45000;       // Disconnect a client silent this long (ms, 0 = never)
+  int relayRateMessages = 0;          // Max messages/s from one client (0 = unlimited)
+  int relayRateBytes = 0;             // Max bytes/s from one client (0 = unlimited)
+  bool relayThrottleNotice = true;    // Tell clients when their messages are dropped
+  int relayDeflateThreshold = 1024;   // Compress broadcasts this big for clients that ask (0 = off)
+  
+  // Static files
+  int httpCacheBytes = 0;             // RAM for cached files (0 = auto, -1 = off)
+  int httpCacheMaxFile = 16384;       // Largest file worth caching
+  bool httpFileIndex = true;          // Index the card at boot so lookups skip the FAT
+  String httpCacheControl = "no-cache";  // Browser caching unless a game's manifest says otherwise
+  
+  // Serial logging, per module (LOG_LEVEL_*)
+  uint8_t logLevels[(uint8_t)LogModule::COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO
+  };
 };
 
 class ConfigManager {
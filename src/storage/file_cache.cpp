@@ -0,0 +1,235 @@
+#include "file_cache.h"
+#include "sd_card.h"
+
+CachedFile FileCache::entries[FileCache::MAX_ENTRIES];
+FileCacheStats FileCache::stats = {};
+size_t FileCache::maxFileSize = 0;
+uint32_t FileCache::useCounter = 0;
+uint32_t FileCache::generation = 0;
+
+void FileCache::init(size_t budget, size_t maxFile) {
+  stats.psram = psramFound();
+  if (budget == 0) {
+    budget = stats.psram ? 1024 * 1024 : 32 * 1024;
+  }
+  
+  stats.budget = budget;
+  maxFileSize = maxFile < budget ? maxFile : budget;
+  generation = SDCard::getGeneration();
+  
+  Serial.printf("File cache: %u KB in %s, files up to %u KB\n",
+                (unsigned)(budget / 1024), stats.psram ? "PSRAM" : "RAM",
+                (unsigned)(maxFileSize / 1024));
+}
+
+// FNV-1a, so most lookups never get as far as strcmp
+uint32_t FileCache::hash(const char* path) {
+  uint32_t h = 2166136261UL;
+  while (*path) {
+    h ^= (uint8_t)*path++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+const CachedFile* FileCache::get(const String& path, File* uncached) {
+  if (stats.budget == 0) {
+    return nullptr;
+  }
+  const CachedFile* hit = lookup(path);
+  if (hit != nullptr) {
+    return hit;
+  }
+  
+  // Miss: only small files are worth holding on to
+  File file = SDCard::openFile(path);
+  if (!file || file.isDirectory()) {
+    return nullptr;
+  }
+  size_t size = file.size();
+  if (size > maxFileSize) {
+    stats.uncacheable++;
+    if (uncached != nullptr) {
+      *uncached = file;
+    } else {
+      file.close();
+    }
+    return nullptr;
+  }
+  return load(path, file, size);
+}
+
+const CachedFile* FileCache::get(const String& key, const String& openPath,
+                                 uint32_t offset, size_t length) {
+  if (stats.budget == 0) {
+    return nullptr;
+  }
+  const CachedFile* hit = lookup(key);
+  if (hit != nullptr) {
+    return hit;
+  }
+  
+  if (length > maxFileSize) {
+    stats.uncacheable++;
+    return nullptr;
+  }
+  File file = SDCard::openFile(openPath);
+  if (!file || !file.seek(offset)) {
+    return nullptr;
+  }
+  return load(key, file, length);
+}
+
+// Hit: counted and held for the caller. nullptr on a miss.
+const CachedFile* FileCache::lookup(const String& key) {
+  // Card was swapped: nothing here can be trusted
+  if (generation != SDCard::getGeneration()) {
+    clear();
+    generation = SDCard::getGeneration();
+  }
+  
+  uint32_t h = hash(key.c_str());
+  for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+    CachedFile& entry = entries[i];
+    if (entry.block != nullptr && !entry.stale && entry.pathHash == h &&
+        strcmp(entry.path, key.c_str()) == 0) {
+      entry.lastUsed = ++useCounter;
+      entry.users++;
+      stats.hits++;
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+// Read `size` bytes from where the file is positioned into a new entry
+// under `key`. Closes the file.
+const CachedFile* FileCache::load(const String& key, File& file, size_t size) {
+  size_t pathBytes = key.length() + 1;
+  if (size > maxFileSize || !makeRoom(size + pathBytes)) {
+    file.close();
+    stats.uncacheable++;
+    return nullptr;
+  }
+  
+  uint8_t slot = MAX_ENTRIES;
+  for (uint8_t i = 0; i < MAX_ENTRIES && slot == MAX_ENTRIES; i++) {
+    if (entries[i].block == nullptr) {
+      slot = i;
+    }
+  }
+  
+  void* block = allocate(size + pathBytes);
+  if (block == nullptr) {
+    file.close();
+    stats.uncacheable++;
+    return nullptr;
+  }
+  
+  uint8_t* data = (uint8_t*)block;
+  size_t read = file.read(data, size);
+  time_t lastWrite = file.getLastWrite();
+  file.close();
+  if (read != size) {
+    free(block);
+    return nullptr;
+  }
+  
+  char* storedPath = (char*)(data + size);
+  memcpy(storedPath, key.c_str(), pathBytes);
+  
+  CachedFile& entry = entries[slot];
+  entry.pathHash = hash(storedPath);
+  entry.path = storedPath;
+  entry.data = data;
+  entry.size = size;
+  entry.lastWrite = lastWrite;
+  entry.lastUsed = ++useCounter;
+  entry.users = 1;
+  entry.stale = false;
+  entry.block = block;
+  
+  stats.misses++;
+  stats.entries++;
+  stats.bytesUsed += size + pathBytes;
+  return &entry;
+}
+
+// Evict least recently used files until `bytes` fit in the budget and a
+// slot is free
+bool FileCache::makeRoom(size_t bytes) {
+  if (bytes > stats.budget) {
+    return false;
+  }
+  
+  while (stats.bytesUsed + bytes > stats.budget || stats.entries >= MAX_ENTRIES) {
+    uint8_t oldest = MAX_ENTRIES;
+    for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+      if (entries[i].block != nullptr && entries[i].users == 0 &&
+          (oldest == MAX_ENTRIES || entries[i].lastUsed < entries[oldest].lastUsed)) {
+        oldest = i;
+      }
+    }
+    if (oldest == MAX_ENTRIES) {
+      return false;
+    }
+    evict(oldest);
+    stats.evictions++;
+  }
+  return true;
+}
+
+void FileCache::evict(uint8_t index) {
+  CachedFile& entry = entries[index];
+  free(entry.block);
+  stats.bytesUsed -= entry.size + strlen(entry.path) + 1;
+  stats.entries--;
+  entry.block = nullptr;
+}
+
+void FileCache::release(const CachedFile* file) {
+  if (file == nullptr) {
+    return;
+  }
+  
+  uint8_t index = file - entries;
+  CachedFile& entry = entries[index];
+  if (entry.users > 0) {
+    entry.users--;
+  }
+  if (entry.stale && entry.users == 0) {
+    evict(index);
+  }
+}
+
+bool FileCache::fits(size_t size) {
+  return stats.budget > 0 && size <= maxFileSize;
+}
+
+void FileCache::clear() {
+  for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+    if (entries[i].block == nullptr) {
+      continue;
+    }
+    if (entries[i].users > 0) {
+      entries[i].stale = true;
+    } else {
+      evict(i);
+    }
+  }
+}
+
+void* FileCache::allocate(size_t bytes) {
+  // PSRAM is slower than internal RAM but still far faster than SPI SD
+  if (stats.psram) {
+    void* block = ps_malloc(bytes);
+    if (block != nullptr) {
+      return block;
+    }
+  }
+  return malloc(bytes);
+}
+
+const FileCacheStats& FileCache::getStats() {
+  return stats;
+}
@@ -0,0 +1,77 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+// A file held in RAM. Path and contents share one allocation.
+struct CachedFile {
+  uint32_t pathHash;
+  const char* path;     // Or "<cartridge>:<asset>" for a packed file
+  const uint8_t* data;
+  size_t size;
+  time_t lastWrite;     // File's mtime, for validators
+  uint32_t lastUsed;    // LRU stamp
+  uint8_t users;        // Responses still sending from it; never evicted while > 0
+  bool stale;           // Card changed while in use: freed on last release()
+  void* block;          // nullptr = free slot
+};
+
+struct FileCacheStats {
+  uint32_t hits;
+  uint32_t misses;       // Loaded from SD into the cache
+  uint32_t uncacheable;  // Too big (or no memory), served from SD
+  uint32_t evictions;
+  uint32_t bytesUsed;
+  uint32_t budget;
+  uint8_t entries;
+  bool psram;
+};
+
+// Byte-budgeted LRU cache of small files from the SD card, so the same
+// index.html/JS requested by every phone at the start of a round is read
+// from the card once. Uses PSRAM when the board has it. Everything is
+// dropped when the card is swapped.
+class FileCache {
+public:
+  // budget 0 = automatic (1 MB with PSRAM, 32 KB without)
+  static void init(size_t budget, size_t maxFileSize);
+  
+  // Cached file for this path, reading it from SD on a miss. nullptr if it
+  // doesn't exist, is too big to cache, or there's no memory for it. The
+  // entry stays valid until it's handed back with release(). A file too big
+  // to cache is left open in `uncached` (if given), so the caller sending it
+  // from the card doesn't open it a second time.
+  static const CachedFile* get(const String& path, File* uncached = nullptr);
+  
+  // Same for a slice of a file - an asset inside a cartridge - cached under
+  // its own key ("/games/foo.lpa:/index.html")
+  static const CachedFile* get(const String& key, const String& openPath,
+                               uint32_t offset, size_t length);
+  static void release(const CachedFile* file);
+  
+  // Whether a file this big would be cached at all
+  static bool fits(size_t size);
+  
+  // Drop everything (files still being sent go when they're released)
+  static void clear();
+  
+  static const FileCacheStats& getStats();
+
+private:
+  static const uint8_t MAX_ENTRIES = 32;
+  static CachedFile entries[MAX_ENTRIES];
+  static FileCacheStats stats;
+  static size_t maxFileSize;
+  static uint32_t useCounter;
+  static uint32_t generation;   // SD card generation the contents came from
+  
+  static uint32_t hash(const char* path);
+  static const CachedFile* lookup(const String& key);
+  static const CachedFile* load(const String& key, File& file, size_t size);
+  static void evict(uint8_t index);
+  static bool makeRoom(size_t bytes);
+  static void* allocate(size_t bytes);
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "file_index.h"
+#include "sd_card.h"
+#include "utils/logger.h"
+
+FileEntry* FileIndex::entries = nullptr;
+uint16_t FileIndex::capacity = 0;
+char* FileIndex::paths = nullptr;
+uint32_t FileIndex::pathsCapacity = 0;
+FileIndexStats FileIndex::stats = {};
+bool FileIndex::enabled = false;
+uint32_t FileIndex::generation = 0;
+
+void FileIndex::init(bool enable) {
+  enabled = enable;
+  if (!enabled) {
+    Serial.println("File index: off (every request asks the SD card)");
+    return;
+  }
+  build();
+}
+
+void FileIndex::build() {
+  uint32_t building = SDCard::getGeneration();
+  unsigned long started = millis();
+  Table table = {};
+  String samples[BENCHMARK_SAMPLES];
+  uint8_t sampleCount = 0;
+  bool scanned = false;
+  
+  if (enabled && SDCard::isMounted()) {
+    File root;
+    {
+      SDLock sd;
+      root = SDCard::openFile("/");
+      scanned = root && root.isDirectory();
+    }
+    if (scanned) {
+      // Takes the SD lock per entry, so requests keep being served (from
+      // the old index, or the card) while this runs
+      scanDirectory(root, 0, table, samples, sampleCount);
+      sort(table);
+    } else {
+      LOG_WARN(LogModule::STORAGE, "[FileIndex] Can't open / - falling back to SD lookups");
+    }
+    SDLock sd;
+    root.close();
+  }
+  
+  bool overflowed = table.overflowed;
+  if (overflowed) {
+    free(table.entries);
+    free(table.paths);
+    table = {};
+  }
+  
+  // Swap the new entries in. HTTP holds the SD lock for its whole pass, so
+  // no request is still looking at the old ones.
+  FileEntry* old;
+  char* oldPaths;
+  {
+    SDLock sd;
+    old = entries;
+    oldPaths = paths;
+    entries = table.entries;
+    capacity = table.capacity;
+    paths = table.paths;
+    pathsCapacity = table.pathsCapacity;
+    stats.files = table.count;
+    stats.scanMillis = millis() - started;
+    stats.memoryBytes = (uint32_t)capacity * sizeof(FileEntry) + pathsCapacity;
+    stats.ready = scanned && !overflowed;
+    generation = building;
+  }
+  free(old);
+  free(oldPaths);
+  
+  if (!scanned) {
+    return;
+  }
+  if (overflowed) {
+    LOG_WARN(LogModule::STORAGE, "[FileIndex] More than %u files - falling back to SD lookups", (unsigned)MAX_FILES);
+    return;
+  }
+  LOG_INFO(LogModule::STORAGE, "[FileIndex] %u files indexed in %lu ms (%lu bytes)",
+           (unsigned)stats.files, (unsigned long)stats.scanMillis,
+           (unsigned long)stats.memoryBytes);
+  benchmark(samples, sampleCount);
+}
+
+void FileIndex::refresh() {
+  if (enabled && generation != SDCard::getGeneration()) {
+    build();
+  }
+}
+
+void FileIndex::scanDirectory(File& dir, uint8_t depth, Table& table, String* samples, uint8_t& sampleCount) {
+  while (!table.overflowed) {
+    SDCard::lock();
+    File entry = dir.openNextFile();
+    if (!entry) {
+      SDCard::unlock();
+      return;
+    }
+    
+    const char* path = entry.path();
+    const char* slash = strrchr(path, '/');
+    const char* name = slash != nullptr ? slash + 1 : path;
+    
+    // Hidden files and what the OS leaves behind on the card aren't served
+    bool skip = name[0] == '.' || strcmp(name, "System Volume Information") == 0;
+    if (!skip) {
+      if (entry.isDirectory()) {
+        if (depth < MAX_DEPTH) {
+          SDCard::unlock();
+          scanDirectory(entry, depth + 1, table, samples, sampleCount);
+          SDCard::lock();
+        }
+      } else if (add(table, path, entry.size(), entry.getLastWrite())) {
+        if (sampleCount < BENCHMARK_SAMPLES) {
+          samples[sampleCount++] = path;
+        }
+      }
+    }
+    
+    entry.close();
+    SDCard::unlock();
+  }
+}
+
+// PSRAM when there is some
+static void* reallocate(void* block, size_t bytes) {
+  return psramFound() ? ps_realloc(block, bytes) : realloc(block, bytes);
+}
+
+bool FileIndex::add(Table& table, const char* path, size_t size, time_t lastWrite) {
+  if (table.count >= table.capacity) {
+    if (table.capacity >= MAX_FILES) {
+      table.overflowed = true;
+      return false;
+    }
+    
+    // Grow by doubling
+    uint16_t grown = table.capacity == 0 ? 64 : table.capacity * 2;
+    if (grown > MAX_FILES) {
+      grown = MAX_FILES;
+    }
+    void* block = reallocate(table.entries, (size_t)grown * sizeof(FileEntry));
+    if (block == nullptr) {
+      table.overflowed = true;
+      return false;
+    }
+    table.entries = (FileEntry*)block;
+    table.capacity = grown;
+  }
+  
+  size_t pathLength = strlen(path) + 1;
+  if (table.pathsUsed + pathLength > table.pathsCapacity) {
+    uint32_t grown = table.pathsCapacity == 0 ? 2048 : table.pathsCapacity * 2;
+    while (grown < table.pathsUsed + pathLength) {
+      grown *= 2;
+    }
+    void* block = reallocate(table.paths, grown);
+    if (block == nullptr) {
+      table.overflowed = true;
+      return false;
+    }
+    table.paths = (char*)block;
+    table.pathsCapacity = grown;
+  }
+  
+  FileEntry& entry = table.entries[table.count++];
+  entry.pathHash = hash(path);
+  entry.pathOffset = table.pathsUsed;
+  entry.size = size;
+  entry.lastWrite = (uint32_t)lastWrite;
+  memcpy(table.paths + table.pathsUsed, path, pathLength);
+  table.pathsUsed += pathLength;
+  return true;
+}
+
+static int compareEntries(const void* a, const void* b) {
+  uint32_t ha = ((const FileEntry*)a)->pathHash;
+  uint32_t hb = ((const FileEntry*)b)->pathHash;
+  return ha < hb ? -1 : (ha > hb ? 1 : 0);
+}
+
+// Paths that share a hash end up next to each other; find() tells them
+// apart by the path
+void FileIndex::sort(Table& table) {
+  qsort(table.entries, table.count, sizeof(FileEntry), compareEntries);
+}
+
+bool FileIndex::isReady() {
+  // Until refresh() has caught up with a swapped card, ask the card itself
+  return enabled && stats.ready && generation == SDCard::getGeneration();
+}
+
+const FileEntry* FileIndex::find(const String& path) {
+  uint32_t h = hash(path.c_str());
+  
+  // First entry with this hash
+  uint16_t low = 0;
+  uint16_t high = stats.files;
+  while (low < high) {
+    uint16_t mid = (low + high) / 2;
+    if (entries[mid].pathHash < h) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  
+  // A path that isn't on the card can still share a hash with one that is,
+  // so the stored path has the final say (ignoring case, as FAT does)
+  for (uint16_t i = low; i < stats.files && entries[i].pathHash == h; i++) {
+    if (strcasecmp(paths + entries[i].pathOffset, path.c_str()) == 0) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+// Time the lookup a request used to do (exists + open) against the index,
+// on a few real paths, so the difference shows in the boot log
+void FileIndex::benchmark(const String* samples, uint8_t count) {
+  if (count == 0) {
+    return;
+  }
+  
+  SDLock sd;
+  unsigned long started = micros();
+  for (uint8_t i = 0; i < count; i++) {
+    if (SD.exists(samples[i])) {
+      File file = SD.open(samples[i], FILE_READ);
+      file.close();
+    }
+  }
+  unsigned long sdMicros = (micros() - started) / count;
+  
+  started = micros();
+  for (uint8_t i = 0; i < count; i++) {
+    find(samples[i]);
+  }
+  unsigned long indexMicros = (micros() - started) / count;
+  
+  LOG_INFO(LogModule::STORAGE, "[FileIndex] Lookup: %lu us from SD (exists + open), %lu us from index",
+           sdMicros, indexMicros);
+}
+
+// FNV-1a over the lower-cased path: FAT finds /Index.HTML as /index.html,
+// so the index has to as well
+uint32_t FileIndex::hash(const char* path) {
+  uint32_t h = 2166136261UL;
+  while (*path) {
+    uint8_t c = (uint8_t)*path++;
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    h ^= c;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+const FileIndexStats& FileIndex::getStats() {
+  return stats;
+}
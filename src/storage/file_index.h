@@ -0,0 +1,80 @@
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+// What the web server needs to know about a file without asking the card
+struct FileEntry {
+  uint32_t pathHash;
+  uint32_t pathOffset;  // Into the index's path pool
+  uint32_t size;
+  uint32_t lastWrite;   // mtime, for validators
+};
+
+struct FileIndexStats {
+  uint16_t files;
+  uint32_t memoryBytes;
+  uint32_t scanMillis;
+  bool ready;
+};
+
+// Every file on the SD card, scanned once at mount and kept sorted by path
+// hash. Requests resolve with a binary search instead of walking the FAT
+// directory chain (twice: exists, then open), and a 404 never touches the
+// card. Paths hash case-insensitively, like FAT looks them up. The paths
+// themselves are kept too, so a hash match is confirmed before it's used.
+class FileIndex {
+public:
+  static void init(bool enabled);
+  
+  // Scan the card now (blocks for the length of the scan). The new index
+  // replaces the old one only once it's complete.
+  static void build();
+  
+  // Rebuild if the card changed since the last build. Called from the UI
+  // task after SDCard::poll(), so no request waits for the scan.
+  static void refresh();
+  
+  // False when disabled, the card isn't mounted, it had too many files or
+  // it changed and the rebuild hasn't finished; callers then fall back to
+  // asking the card
+  static bool isReady();
+  
+  // nullptr = no such file (only meaningful when isReady())
+  static const FileEntry* find(const String& path);
+  
+  static const FileIndexStats& getStats();
+
+private:
+  static const uint16_t MAX_FILES = 4096;
+  static const uint8_t MAX_DEPTH = 8;
+  static const uint8_t BENCHMARK_SAMPLES = 4;
+  
+  // Entries being scanned, before they're swapped in
+  struct Table {
+    FileEntry* entries;
+    uint16_t capacity;
+    uint16_t count;
+    char* paths;            // NUL-terminated, back to back
+    uint32_t pathsCapacity;
+    uint32_t pathsUsed;
+    bool overflowed;
+  };
+  
+  static FileEntry* entries;
+  static uint16_t capacity;
+  static char* paths;
+  static uint32_t pathsCapacity;
+  static FileIndexStats stats;
+  static bool enabled;
+  static uint32_t generation;   // SD card generation the index was built from
+  
+  static void scanDirectory(File& dir, uint8_t depth, Table& table, String* samples, uint8_t& sampleCount);
+  static bool add(Table& table, const char* path, size_t size, time_t lastWrite);
+  static void sort(Table& table);
+  static void benchmark(const String* samples, uint8_t count);
+  static uint32_t hash(const char* path);
+};
+
+#endif
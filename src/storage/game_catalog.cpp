@@ -0,0 +1,307 @@
+#include "game_catalog.h"
+#include "sd_card.h"
+#include "cartridge.h"
+#include "utils/logger.h"
+#include <ArduinoJson.h>
+
+GameManifest GameCatalog::games[GameCatalog::MAX_GAMES];
+GameManifest GameCatalog::spare;
+uint8_t GameCatalog::gameCount = 0;
+bool GameCatalog::overflowed = false;
+uint32_t GameCatalog::generation = 0;
+String GameCatalog::json = "{\"games\":[]}";
+
+void GameCatalog::scan() {
+  uint32_t scanning = SDCard::getGeneration();
+  Listing listing = {};
+  listing.games = (GameManifest*)malloc(sizeof(GameManifest) * MAX_GAMES);
+  if (listing.games == nullptr) {
+    LOG_WARN(LogModule::STORAGE, "[Games] Out of memory - keeping the old catalog");
+    return;
+  }
+  
+  File root;
+  bool listed;
+  {
+    SDLock sd;
+    root = SDCard::openFile("/games");
+    listed = root && root.isDirectory();
+  }
+  if (listed) {
+    // The SD lock is taken per entry (and per manifest), so requests and the
+    // relay carry on with the old catalog while this runs
+    unsigned long started = millis();
+    while (true) {
+      SDCard::lock();
+      File dir = root.openNextFile();
+      SDCard::unlock();
+      if (!dir) {
+        break;
+      }
+      
+      const char* path = dir.path();
+      const char* slash = strrchr(path, '/');
+      const char* name = slash != nullptr ? slash + 1 : path;
+      const char* dot = strrchr(name, '.');
+      
+      if (dir.isDirectory() && isValidFolder(name)) {
+        GameManifest* manifest = add(listing, name, false);
+        if (manifest != nullptr) {
+          manifest->totalBytes = folderSize(dir, 0);
+        }
+      } else if (!dir.isDirectory() && dot != nullptr && strcmp(dot, ".lpa") == 0 &&
+                 (size_t)(dot - name) <= GAME_FOLDER_MAX_LENGTH) {
+        // Packed cartridge: the game's folder name is the file name
+        char folder[GAME_FOLDER_MAX_LENGTH + 1];
+        memcpy(folder, name, dot - name);
+        folder[dot - name] = '\0';
+        GameManifest* manifest = isValidFolder(folder) ? add(listing, folder, true) : nullptr;
+        if (manifest != nullptr) {
+          manifest->totalBytes = dir.size();
+        }
+      }
+      
+      SDLock sd;
+      dir.close();
+    }
+    
+    LOG_INFO(LogModule::STORAGE, "[Games] %u games catalogued in %lu ms%s", (unsigned)listing.count,
+             millis() - started, listing.overflowed ? " (catalog full - rest loaded on demand)" : "");
+  }
+  String serialized = serialize(listing);
+  
+  // Swap the new catalog in. Whoever holds a manifest holds the SD lock too.
+  {
+    SDLock sd;
+    root.close();
+    memcpy(games, listing.games, sizeof(GameManifest) * listing.count);
+    gameCount = listing.count;
+    overflowed = listing.overflowed;
+    spare.folder[0] = '\0';
+    json = serialized;
+    generation = scanning;
+  }
+  free(listing.games);
+}
+
+// Catalog a game found by scan(). When there's both a folder and a .lpa of
+// the same name the .lpa wins, so a packed copy can be dropped in beside the
+// original. nullptr if there's nothing (more) to fill in.
+GameManifest* GameCatalog::add(Listing& listing, const char* folder, bool packed) {
+  for (uint8_t i = 0; i < listing.count; i++) {
+    if (strcmp(listing.games[i].folder, folder) == 0) {
+      if (!packed) {
+        return nullptr;
+      }
+      LOG_WARN(LogModule::STORAGE, "[Games] '%s' has a folder and a .lpa - serving the .lpa", folder);
+      load(folder, listing.games[i], true);
+      return &listing.games[i];
+    }
+  }
+  
+  if (listing.count >= MAX_GAMES) {
+    listing.overflowed = true;
+    return nullptr;
+  }
+  GameManifest& manifest = listing.games[listing.count++];
+  load(folder, manifest, packed);
+  return &manifest;
+}
+
+// Rescan if the card changed since the last one
+void GameCatalog::refresh() {
+  if (generation != SDCard::getGeneration()) {
+    scan();
+  }
+}
+
+const GameManifest* GameCatalog::find(const char* folder) {
+  if (!isValidFolder(folder)) {
+    return nullptr;
+  }
+  
+  for (uint8_t i = 0; i < gameCount; i++) {
+    if (strcmp(games[i].folder, folder) == 0) {
+      return &games[i];
+    }
+  }
+  
+  // Only a card with more games than fit can have one we haven't seen
+  if (!overflowed) {
+    return nullptr;
+  }
+  SDLock sd;
+  if (strcmp(spare.folder, folder) != 0) {
+    load(folder, spare, SDCard::fileExists(String("/games/") + folder + ".lpa"));
+  }
+  return &spare;
+}
+
+const String& GameCatalog::getJson() {
+  return json;
+}
+
+uint32_t GameCatalog::getGeneration() {
+  return generation;
+}
+
+void GameCatalog::clear() {
+  SDLock sd;
+  gameCount = 0;
+  overflowed = false;
+  spare.folder[0] = '\0';
+}
+
+uint32_t GameCatalog::folderSize(File& dir, uint8_t depth) {
+  uint32_t total = 0;
+  while (true) {
+    SDCard::lock();
+    File entry = dir.openNextFile();
+    if (!entry) {
+      SDCard::unlock();
+      return total;
+    }
+    
+    if (!entry.isDirectory()) {
+      total += entry.size();
+    } else if (depth < MAX_SIZE_DEPTH) {
+      SDCard::unlock();
+      total += folderSize(entry, depth + 1);
+      SDCard::lock();
+    }
+    entry.close();
+    SDCard::unlock();
+  }
+}
+
+String GameCatalog::serialize(const Listing& listing) {
+  JsonDocument doc;
+  JsonArray list = doc["games"].to<JsonArray>();
+  for (uint8_t i = 0; i < listing.count; i++) {
+    const GameManifest& manifest = listing.games[i];
+    JsonObject game = list.add<JsonObject>();
+    game["folder"] = manifest.folder;
+    game["name"] = manifest.name;
+    game["entry"] = manifest.entry;
+    game["url"] = String("/games/") + manifest.folder + "/" + manifest.entry;
+    if (manifest.minPlayers >= 0) {
+      game["minPlayers"] = manifest.minPlayers;
+    }
+    if (manifest.maxPlayers >= 0) {
+      game["maxPlayers"] = manifest.maxPlayers;
+    }
+    if (manifest.reconnectGracePeriod >= 0) {
+      game["reconnectGracePeriod"] = manifest.reconnectGracePeriod;
+    }
+    game["bytes"] = manifest.totalBytes;
+    game["manifest"] = manifest.found;
+    game["packed"] = manifest.packed;
+  }
+  
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+bool GameCatalog::isValidFolder(const char* folder) {
+  if (folder == nullptr || folder[0] == '\0') {
+    return false;
+  }
+  
+  // Plain names only, so a client can't point us outside /games
+  size_t n = 0;
+  for (; folder[n] != '\0'; n++) {
+    char c = folder[n];
+    bool valid = isalnum((unsigned char)c) || c == '_' || c == '-';
+    if (!valid || n >= GAME_FOLDER_MAX_LENGTH) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GameCatalog::load(const char* folder, GameManifest& manifest, bool packed) {
+  strncpy(manifest.folder, folder, GAME_FOLDER_MAX_LENGTH);
+  manifest.folder[GAME_FOLDER_MAX_LENGTH] = '\0';
+  manifest.found = false;
+  manifest.packed = packed;
+  strncpy(manifest.name, folder, GAME_NAME_MAX_LENGTH);
+  manifest.name[GAME_NAME_MAX_LENGTH] = '\0';
+  strcpy(manifest.entry, "index.html");
+  manifest.minPlayers = -1;
+  manifest.maxPlayers = -1;
+  manifest.totalBytes = 0;
+  manifest.reconnectGracePeriod = -1;
+  manifest.maxMessagesPerSecond = -1;
+  manifest.maxBytesPerSecond = -1;
+  manifest.cacheControl[0] = '\0';
+  
+  SDLock sd;
+  File file;
+  if (packed) {
+    // Read it straight out of the cartridge
+    CartridgeEntry entry;
+    file = SDCard::openFile(String("/games/") + folder + ".lpa");
+    if (file && !CartridgeStore::seekTo(file, "/manifest.json", entry)) {
+      file.close();
+    }
+  } else {
+    file = SDCard::openFile(String("/games/") + folder + "/manifest.json");
+  }
+  if (!file) {
+    LOG_INFO(LogModule::STORAGE, "[Games] No manifest for '%s' - using defaults", folder);
+    return;
+  }
+  
+  // Only pull out the fields the firmware uses
+  JsonDocument filter;
+  filter["name"] = true;
+  filter["entry"] = true;
+  filter["minPlayers"] = true;
+  filter["maxPlayers"] = true;
+  filter["reconnectGracePeriod"] = true;
+  filter["maxMessagesPerSecond"] = true;
+  filter["maxBytesPerSecond"] = true;
+  filter["cacheControl"] = true;
+  
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, file, DeserializationOption::Filter(filter));
+  file.close();
+  
+  if (error) {
+    LOG_WARN(LogModule::STORAGE, "[Games] %s: manifest parse error: %s", folder, error.c_str());
+    return;
+  }
+  
+  manifest.found = true;
+  if (doc["name"].is<const char*>()) {
+    strncpy(manifest.name, doc["name"], GAME_NAME_MAX_LENGTH);
+    manifest.name[GAME_NAME_MAX_LENGTH] = '\0';
+  }
+  if (doc["entry"].is<const char*>()) {
+    strncpy(manifest.entry, doc["entry"], GAME_NAME_MAX_LENGTH);
+    manifest.entry[GAME_NAME_MAX_LENGTH] = '\0';
+  }
+  if (doc["minPlayers"].is<int>()) {
+    manifest.minPlayers = doc["minPlayers"];
+  }
+  if (doc["maxPlayers"].is<int>()) {
+    manifest.maxPlayers = doc["maxPlayers"];
+  }
+  if (doc["reconnectGracePeriod"].is<int>()) {
+    manifest.reconnectGracePeriod = doc["reconnectGracePeriod"];
+  }
+  if (doc["maxMessagesPerSecond"].is<int>()) {
+    manifest.maxMessagesPerSecond = doc["maxMessagesPerSecond"];
+  }
+  if (doc["maxBytesPerSecond"].is<int>()) {
+    manifest.maxBytesPerSecond = doc["maxBytesPerSecond"];
+  }
+  if (doc["cacheControl"].is<const char*>()) {
+    strncpy(manifest.cacheControl, doc["cacheControl"], CACHE_CONTROL_MAX_LENGTH);
+    manifest.cacheControl[CACHE_CONTROL_MAX_LENGTH] = '\0';
+  }
+  
+  LOG_INFO(LogModule::STORAGE, "[Games] Loaded manifest for '%s': %s (grace period: %ld s)",
+           folder, manifest.name, (long)manifest.reconnectGracePeriod);
+}
@@ -0,0 +1,79 @@
+#ifndef GAME_CATALOG_H
+#define GAME_CATALOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Game folders live under /games on the SD card
+static const size_t GAME_FOLDER_MAX_LENGTH = 31;
+static const size_t GAME_NAME_MAX_LENGTH = 31;
+static const size_t CACHE_CONTROL_MAX_LENGTH = 47;
+
+// Settings a game can declare in /games/<folder>/manifest.json
+struct GameManifest {
+  char folder[GAME_FOLDER_MAX_LENGTH + 1];
+  bool found;                     // false = no (readable) manifest, defaults apply
+  bool packed;                    // Served from /games/<folder>.lpa
+  char name[GAME_NAME_MAX_LENGTH + 1];    // Display name (folder if not set)
+  char entry[GAME_NAME_MAX_LENGTH + 1];   // Page to open, relative to the folder
+  int16_t minPlayers;             // -1 = not set
+  int16_t maxPlayers;
+  uint32_t totalBytes;            // Everything in the folder (or the .lpa)
+  int32_t reconnectGracePeriod;   // Seconds, -1 = not set (use config.json)
+  int32_t maxMessagesPerSecond;   // Per-player inbound limits, -1 = not set,
+  int32_t maxBytesPerSecond;      // 0 = unlimited
+  char cacheControl[CACHE_CONTROL_MAX_LENGTH + 1];  // For the game's files, "" = not set
+};
+
+// Every game on the card - loose folders and packed cartridges - read once at mount (and again after a card swap)
+// so neither the relay nor the lobby page has to go to the SD card for it.
+class GameCatalog {
+public:
+  // Read /games/*/manifest.json and /games/*.lpa now (blocks for the length
+  // of the scan). The new catalog replaces the old one only once it's complete.
+  static void scan();
+  
+  // Rescan if the card changed since the last scan. Called from the UI task
+  // after SDCard::poll(), so lookups never wait for the card.
+  static void refresh();
+  
+  // Manifest for a game folder. nullptr if the folder name isn't valid or
+  // there's no such game. Only goes to the card for a game past MAX_GAMES.
+  // Hold the SD lock while using it: a rescan swaps the catalog under it.
+  static const GameManifest* find(const char* folder);
+  
+  // The whole catalog for /api/games, serialized once per scan:
+  // { "games": [ { "folder", "name", "entry", "url", "minPlayers", ... } ] }
+  static const String& getJson();
+  
+  // Changes with every scan, for ETags
+  static uint32_t getGeneration();
+  
+  // Forget cached manifests (e.g. after the card was swapped)
+  static void clear();
+
+private:
+  static const uint8_t MAX_GAMES = 32;
+  static const uint8_t MAX_SIZE_DEPTH = 4;
+  // Games being scanned, before they're swapped in
+  struct Listing {
+    GameManifest* games;
+    uint8_t count;
+    bool overflowed;
+  };
+  
+  static GameManifest games[MAX_GAMES];
+  static GameManifest spare;    // Lazily loaded when there are more than MAX_GAMES
+  static uint8_t gameCount;
+  static bool overflowed;
+  static uint32_t generation;   // SD card generation the manifests came from
+  static String json;
+  
+  static bool isValidFolder(const char* folder);
+  static GameManifest* add(Listing& listing, const char* folder, bool packed);
+  static void load(const char* folder, GameManifest& manifest, bool packed);
+  static uint32_t folderSize(File& dir, uint8_t depth);
+  static String serialize(const Listing& listing);
+};
+
+#endif
@@ -1,7 +1,16 @@
 #include "sd_card.h"
 #include <SPI.h>
+#include "utils/logger.h"
 
-bool SDCard::mounted = false;
+std::atomic<bool> SDCard::mounted(false);
+uint8_t SDCard::csPin = 0;
+std::atomic<uint32_t> SDCard::generation(0);
+SemaphoreHandle_t SDCard::busLock = nullptr;
+unsigned long SDCard::lastPoll = 0;
+
+// How often to check the card is still there, and to retry mounting one
+static const unsigned long CARD_CHECK_MS = 2000;
+static const unsigned long CARD_RETRY_MS = 5000;
 
 bool SDCard::init(uint8_t cs_pin) {
   Serial.println("\nInitializing SD card...");
@@ -10,6 +19,14 @@ bool SDCard::init(uint8_t cs_pin) {
   // MOSI=23, MISO=19, SCK=18, CS=5
   delay(100); // Give SD card time to power up
   
+  if (busLock == nullptr) {
+    busLock = xSemaphoreCreateRecursiveMutex();
+  }
+  
+  csPin = cs_pin;
+  lastPoll = millis();
+  generation++;
+  
   if (SD.begin(cs_pin, SPI, 25000000)) {
     mounted = true;
     Serial.println("SD card mounted successfully!");
@@ -43,3 +60,50 @@ File SDCard::openFile(const String& path, const char* mode) {
   if (!mounted) return File();
   return SD.open(path, mode);
 }
+
+void SDCard::poll() {
+  unsigned long now = millis();
+  if (now - lastPoll < (mounted ? CARD_CHECK_MS : CARD_RETRY_MS)) {
+    return;
+  }
+  lastPoll = now;
+  
+  // Waits out any HTTP read in progress, so the card never goes away under it
+  SDLock sd;
+  if (mounted) {
+    // The library doesn't notice a pulled card until a read fails
+    File root = SD.open("/");
+    if (root) {
+      root.close();
+      return;
+    }
+    
+    LOG_WARN(LogModule::STORAGE, "SD card removed!");
+    SD.end();
+    mounted = false;
+    generation++;
+    return;
+  }
+  
+  if (SD.begin(csPin, SPI, 25000000)) {
+    LOG_INFO(LogModule::STORAGE, "SD card inserted - remounted");
+    mounted = true;
+    generation++;
+  }
+}
+
+uint32_t SDCard::getGeneration() {
+  return generation;
+}
+
+void SDCard::lock() {
+  if (busLock != nullptr) {
+    xSemaphoreTakeRecursive(busLock, portMAX_DELAY);
+  }
+}
+
+void SDCard::unlock() {
+  if (busLock != nullptr) {
+    xSemaphoreGiveRecursive(busLock);
+  }
+}
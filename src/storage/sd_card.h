@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <SD.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 class SDCard {
 public:
@@ -20,9 +23,35 @@ public:
   
   // Open file for reading
   static File openFile(const String& path, const char* mode = FILE_READ);
+  
+  // Notice the card being pulled or (re)inserted (call in loop)
+  static void poll();
+  
+  // Changes whenever the card is mounted or lost; anything cached from the
+  // card is stale once this moves on
+  static uint32_t getGeneration();
+  
+  // The card is shared by the network task (HTTP) and the UI task (card
+  // checks, header image). Hold this around any SD access outside setup();
+  // it's recursive, so helpers can take it again. Use SDLock where you can.
+  static void lock();
+  static void unlock();
 
 private:
-  static bool mounted;
+  static std::atomic<bool> mounted;
+  static uint8_t csPin;
+  static std::atomic<uint32_t> generation;
+  static SemaphoreHandle_t busLock;
+  static unsigned long lastPoll;
+};
+
+// Holds the SD bus for the rest of the scope
+class SDLock {
+public:
+  SDLock() { SDCard::lock(); }
+  ~SDLock() { SDCard::unlock(); }
+  SDLock(const SDLock&) = delete;
+  SDLock& operator=(const SDLock&) = delete;
 };
 
 #endif
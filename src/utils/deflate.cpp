@@ -0,0 +1,194 @@
+#include "deflate.h"
+#include <stdlib.h>
+#include <string.h>
+
+// RFC 1951 3.2.5: base values and extra bits for length codes 257-285
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// ...and for distance codes 0-29
+static const uint16_t DISTANCE_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+bool DeflateEncoder::init() {
+  if (head != nullptr) {
+    return true;
+  }
+  
+  head = (uint16_t*)malloc(HASH_SIZE * sizeof(uint16_t));
+  prev = (uint16_t*)malloc(WINDOW_SIZE * sizeof(uint16_t));
+  if (head == nullptr || prev == nullptr) {
+    free(head);
+    free(prev);
+    head = nullptr;
+    prev = nullptr;
+    return false;
+  }
+  return true;
+}
+
+uint32_t DeflateEncoder::hash(const uint8_t* p) {
+  uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+  return (uint32_t)(v * 2654435761UL) >> (32 - HASH_BITS);
+}
+
+void DeflateEncoder::insert(const uint8_t* in, size_t pos) {
+  uint32_t h = hash(in + pos);
+  prev[pos & (WINDOW_SIZE - 1)] = head[h];
+  head[h] = pos + 1;
+}
+
+size_t DeflateEncoder::compress(const uint8_t* in, size_t length, uint8_t* out, size_t outSize) {
+  if (head == nullptr || length > MAX_INPUT_LENGTH) {
+    return 0;
+  }
+  
+  output = out;
+  outputSize = outSize;
+  outputPos = 0;
+  bitBuffer = 0;
+  bitCount = 0;
+  overflow = false;
+  
+  // Chains from an earlier call are unreachable once the heads are cleared
+  memset(head, 0, HASH_SIZE * sizeof(uint16_t));
+  
+  // One final block, fixed Huffman codes (BFINAL = 1, BTYPE = 01)
+  putBits(1, 1);
+  putBits(1, 2);
+  
+  size_t pos = 0;
+  while (pos < length && !overflow) {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    
+    if (pos + MIN_MATCH <= length) {
+      size_t maxLength = length - pos < MAX_MATCH ? length - pos : MAX_MATCH;
+      size_t candidate = head[hash(in + pos)];
+      
+      // Walk the chain newest-first; positions must keep going down and stay
+      // inside the window, which also rules out stale slots in `prev`
+      for (uint8_t steps = 0; candidate > 0 && steps < MAX_CHAIN; steps++) {
+        size_t match = candidate - 1;
+        if (match >= pos || pos - match >= WINDOW_SIZE) {
+          break;
+        }
+        
+        if (in[match + bestLength] == in[pos + bestLength]) {
+          size_t n = 0;
+          while (n < maxLength && in[match + n] == in[pos + n]) {
+            n++;
+          }
+          if (n > bestLength) {
+            bestLength = n;
+            bestDistance = pos - match;
+            if (n == maxLength) {
+              break;
+            }
+          }
+        }
+        
+        size_t next = prev[match & (WINDOW_SIZE - 1)];
+        if (next >= candidate) {
+          break;
+        }
+        candidate = next;
+      }
+    }
+    
+    if (bestLength >= MIN_MATCH) {
+      putMatch(bestLength, bestDistance);
+      size_t end = pos + bestLength;
+      for (; pos < end; pos++) {
+        if (pos + MIN_MATCH <= length) {
+          insert(in, pos);
+        }
+      }
+    } else {
+      putLiteral(in[pos]);
+      if (pos + MIN_MATCH <= length) {
+        insert(in, pos);
+      }
+      pos++;
+    }
+  }
+  
+  // End of block
+  putLiteral(256);
+  flushBits();
+  
+  return overflow ? 0 : outputPos;
+}
+
+void DeflateEncoder::putBits(uint32_t bits, uint8_t count) {
+  bitBuffer |= bits << bitCount;
+  bitCount += count;
+  while (bitCount >= 8) {
+    if (outputPos >= outputSize) {
+      overflow = true;
+      bitCount = 0;
+      bitBuffer = 0;
+      return;
+    }
+    output[outputPos++] = bitBuffer & 0xFF;
+    bitBuffer >>= 8;
+    bitCount -= 8;
+  }
+}
+
+// Huffman codes are defined most-significant bit first, the stream is LSB first
+void DeflateEncoder::putHuffman(uint32_t code, uint8_t length) {
+  uint32_t reversed = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  putBits(reversed, length);
+}
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+void DeflateEncoder::putLiteral(uint16_t symbol) {
+  if (symbol < 144) {
+    putHuffman(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    putHuffman(0x190 + (symbol - 144), 9);
+  } else if (symbol < 280) {
+    putHuffman(symbol - 256, 7);
+  } else {
+    putHuffman(0xC0 + (symbol - 280), 8);
+  }
+}
+
+void DeflateEncoder::putMatch(size_t length, size_t distance) {
+  uint8_t code = 28;
+  while (LENGTH_BASE[code] > length) {
+    code--;
+  }
+  putLiteral(257 + code);
+  putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+  
+  code = 29;
+  while (DISTANCE_BASE[code] > distance) {
+    code--;
+  }
+  putHuffman(code, 5);
+  putBits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+void DeflateEncoder::flushBits() {
+  if (bitCount > 0) {
+    putBits(0, 8 - bitCount);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small raw DEFLATE (RFC 1951) encoder: greedy LZ77 over a 4 KB window using
+// hash chains, written as a single fixed-Huffman block. It compresses less
+// than zlib, but its context is ~10 KB where zlib/miniz need hundreds, and
+// repetitive JSON state still shrinks several times over. Any inflater
+// (browsers: DecompressionStream('deflate-raw')) can read the output.
+class DeflateEncoder {
+public:
+  // Allocate the match tables (call once; the context is reused by every call)
+  bool init();
+  
+  // Compress `length` bytes into `out`. Returns the compressed size, or 0 if
+  // it wouldn't fit in `outSize` (pass outSize < length to only accept output
+  // that is actually smaller) or the encoder isn't initialised.
+  size_t compress(const uint8_t* in, size_t length, uint8_t* out, size_t outSize);
+  
+  bool isReady() const { return head != nullptr; }
+
+private:
+  static const size_t WINDOW_SIZE = 4096;
+  static const uint8_t HASH_BITS = 10;
+  static const size_t HASH_SIZE = 1 << HASH_BITS;
+  static const uint8_t MAX_CHAIN = 16;
+  static const size_t MIN_MATCH = 3;
+  static const size_t MAX_MATCH = 258;
+  static const size_t MAX_INPUT_LENGTH = 0xFFFE;   // Positions are stored +1 in 16 bits
+  
+  uint16_t* head = nullptr;   // Hash -> most recent position + 1 (0 = none)
+  uint16_t* prev = nullptr;   // Position in window -> previous position + 1
+  
+  // Bit writer state
+  uint8_t* output;
+  size_t outputSize;
+  size_t outputPos;
+  uint32_t bitBuffer;
+  uint8_t bitCount;
+  bool overflow;
+  
+  static uint32_t hash(const uint8_t* p);
+  void insert(const uint8_t* in, size_t pos);
+  void putBits(uint32_t bits, uint8_t count);
+  void putHuffman(uint32_t code, uint8_t length);
+  void putLiteral(uint16_t symbol);
+  void putMatch(size_t length, size_t distance);
+  void flushBits();
+};
+
+#endif
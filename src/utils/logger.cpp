@@ -0,0 +1,143 @@
+#include "logger.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+Logger::Record Logger::records[LOG_RECORDS];
+std::atomic<uint32_t> Logger::head(0);
+std::atomic<uint32_t> Logger::tail(0);
+std::atomic<uint32_t> Logger::written(0);
+std::atomic<uint32_t> Logger::dropped(0);
+uint8_t Logger::levels[(uint8_t)LogModule::COUNT] = {
+  LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO
+};
+bool Logger::started = false;
+
+static const char* const LEVEL_NAMES[] = { "off", "error", "warn", "info", "debug" };
+static const char* const MODULE_NAMES[] = { "system", "http", "relay", "storage" };
+
+void Logger::begin() {
+  // Just above idle: it only runs when nothing else wants the CPU
+  BaseType_t created = xTaskCreate(drainTask, "log", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+  started = created == pdPASS;
+  if (!started) {
+    Serial.println("Logger: no task - logging synchronously");
+  }
+}
+
+void Logger::setLevel(LogModule module, uint8_t level) {
+  levels[(uint8_t)module] = level;
+}
+
+void Logger::setLevel(uint8_t level) {
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++) {
+    levels[i] = level;
+  }
+}
+
+int Logger::parseLevel(const char* name) {
+  for (uint8_t i = 0; i < sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]); i++) {
+    if (name != nullptr && strcasecmp(name, LEVEL_NAMES[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char* Logger::levelName(uint8_t level) {
+  return level < sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]) ? LEVEL_NAMES[level] : "?";
+}
+
+LogModule Logger::parseModule(const char* name) {
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++) {
+    if (name != nullptr && strcasecmp(name, MODULE_NAMES[i]) == 0) {
+      return (LogModule)i;
+    }
+  }
+  return LogModule::COUNT;
+}
+
+// Multi-producer: writers claim a slot by advancing head, fill it, then mark
+// it ready. The drain task prints slots in claim order as they become ready.
+void Logger::write(LogModule module, uint8_t level, const char* format, ...) {
+  uint32_t slot = head.load(std::memory_order_relaxed);
+  do {
+    if (slot - tail.load(std::memory_order_acquire) >= LOG_RECORDS) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  } while (!head.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed));
+                                       
+  Record& record = records[slot & (LOG_RECORDS - 1)];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(record.text, sizeof(record.text), format, args);
+  va_end(args);
+  
+  if (n < 0) {
+    n = 0;
+  } else if ((size_t)n > LOG_TEXT_MAX_LENGTH) {
+    n = LOG_TEXT_MAX_LENGTH;
+  }
+  // The drain task ends every record with a newline of its own
+  while (n > 0 && record.text[n - 1] == '\n') {
+    n--;
+  }
+  record.length = n;
+  written.fetch_add(1, std::memory_order_relaxed);
+  record.ready.store(true, std::memory_order_release);
+  
+  if (!started) {
+    drain();
+  }
+}
+
+// Print every ready record; false if there were none
+bool Logger::drain() {
+  uint32_t next = tail.load(std::memory_order_relaxed);
+  bool printed = false;
+  while (true) {
+    Record& record = records[next & (LOG_RECORDS - 1)];
+    if (!record.ready.load(std::memory_order_acquire)) {
+      break;
+    }
+    Serial.write((const uint8_t*)record.text, record.length);
+    Serial.write('\n');
+    record.ready.store(false, std::memory_order_relaxed);
+    tail.store(++next, std::memory_order_release);
+    printed = true;
+  }
+  return printed;
+}
+
+void Logger::drainTask(void* param) {
+  uint32_t reported = 0;
+  while (true) {
+    if (!drain()) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    uint32_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost != reported) {
+      Serial.printf("[Log] %lu records dropped\n", (unsigned long)(lost - reported));
+      reported = lost;
+    }
+  }
+}
+
+LogStats Logger::getStats() {
+  LogStats stats;
+  stats.written = written.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void Logger::toJson(JsonObject out) {
+  LogStats stats = getStats();
+  out["written"] = stats.written;
+  out["dropped"] = stats.dropped;
+  JsonObject levelsOut = out["levels"].to<JsonObject>();
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++) {
+    levelsOut[MODULE_NAMES[i]] = levelName(levels[i]);
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Levels as plain numbers so LOG_MAX_LEVEL can be set from build_flags
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Records above this are compiled out entirely (the release env sets WARN)
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Each module's level is set separately with "logLevels" in config.json
+enum class LogModule : uint8_t {
+  SYSTEM,
+  HTTP,
+  RELAY,
+  STORAGE,
+  COUNT
+};
+
+static const size_t LOG_TEXT_MAX_LENGTH = 119;   // Longer records are cut short
+static const size_t LOG_RECORDS = 32;            // Power of two
+
+struct LogStats {
+  uint32_t written;     // Records queued
+  uint32_t dropped;     // Records lost because the buffer was full
+};
+
+// Serial output off the hot path. A log call formats into a slot of a
+// lock-free ring (a few µs) and returns; a low-priority task writes the
+// slots out to the UART, which at 115200 baud takes ~87 µs per byte. When
+// the ring is full the record is dropped and counted rather than waiting.
+class Logger {
+public:
+  // Start the drain task. Records logged earlier wait in the ring.
+  static void begin();
+  
+  // Level for one module, or all of them
+  static void setLevel(LogModule module, uint8_t level);
+  static void setLevel(uint8_t level);
+  
+  // "off", "error", "warn", "info", "debug"; -1 if it's none of them
+  static int parseLevel(const char* name);
+  
+  static const char* levelName(uint8_t level);
+  
+  // "system", "http", "relay", "storage"; COUNT if it's none of them
+  static LogModule parseModule(const char* name);
+  
+  static bool enabled(LogModule module, uint8_t level) {
+    return level <= levels[(uint8_t)module];
+  }
+  
+  // Use the LOG_* macros instead, so disabled records cost one compare
+  static void write(LogModule module, uint8_t level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+    
+  static LogStats getStats();
+  static void toJson(JsonObject out);
+
+private:
+  struct Record {
+    std::atomic<bool> ready;
+    uint8_t length;
+    char text[LOG_TEXT_MAX_LENGTH + 1];
+  };
+  
+  static Record records[LOG_RECORDS];
+  static std::atomic<uint32_t> head;      // Next slot to claim (writers)
+  static std::atomic<uint32_t> tail;      // Next slot to print (drain task)
+  static std::atomic<uint32_t> written;
+  static std::atomic<uint32_t> dropped;
+  static uint8_t levels[(uint8_t)LogModule::COUNT];
+  static bool started;
+  
+  static void drainTask(void* param);
+  static bool drain();
+};
+
+#define LOG_AT(level, module, ...) \
+  do { \
+    if ((level) <= LOG_MAX_LEVEL && Logger::enabled(module, level)) { \
+      Logger::write(module, level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define LOG_WARN(module, ...)  LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#define LOG_INFO(module, ...)  LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+
+#endif
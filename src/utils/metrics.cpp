@@ -0,0 +1,117 @@
+#include "metrics.h"
+
+Histogram Metrics::relayMicros;
+Histogram Metrics::fanOut;
+Histogram Metrics::bytesIn;
+Histogram Metrics::bytesOut;
+Histogram Metrics::loopMicros;
+Histogram Metrics::httpMicros;
+Histogram Metrics::lookupMicros;
+Histogram Metrics::fileKBps;
+
+uint8_t Histogram::bucketFor(uint32_t value) {
+  if (value < LINEAR_BUCKETS) {
+    return value;
+  }
+  
+  uint8_t msb = 31 - __builtin_clz(value);
+  if (msb >= MAX_BIT) {
+    return BUCKETS - 1;
+  }
+  
+  // The 3 bits after the leading one pick the sub-bucket
+  uint8_t sub = (value >> (msb - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+  return LINEAR_BUCKETS + (msb - 4) * (1 << SUB_BUCKET_BITS) + sub;
+}
+
+uint32_t Histogram::upperBound(uint8_t bucket) {
+  if (bucket < LINEAR_BUCKETS) {
+    return bucket;
+  }
+  
+  uint8_t group = (bucket - LINEAR_BUCKETS) >> SUB_BUCKET_BITS;
+  uint8_t sub = (bucket - LINEAR_BUCKETS) & ((1 << SUB_BUCKET_BITS) - 1);
+  uint8_t shift = group + 4 - SUB_BUCKET_BITS;
+  return (((uint32_t)(1 << SUB_BUCKET_BITS) + sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint32_t value) {
+  buckets[bucketFor(value)]++;
+  total++;
+  sum += value;
+  if (value < minValue) minValue = value;
+  if (value > maxValue) maxValue = value;
+}
+
+void Histogram::reset() {
+  memset(buckets, 0, sizeof(buckets));
+  total = 0;
+  sum = 0;
+  minValue = UINT32_MAX;
+  maxValue = 0;
+}
+
+uint32_t Histogram::percentile(uint8_t p) const {
+  if (total == 0) {
+    return 0;
+  }
+  
+  // Rank of the sample we want, rounded up (p99 of 10 samples is the 10th)
+  uint32_t rank = ((uint64_t)total * p + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+  
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      // The last bucket also holds everything too big to bucket
+      uint32_t bound = i < BUCKETS - 1 ? upperBound(i) : maxValue;
+      return bound < maxValue ? bound : maxValue;
+    }
+  }
+  return maxValue;
+}
+
+void Histogram::toJson(JsonObject out) const {
+  out["count"] = total;
+  out["min"] = total > 0 ? minValue : 0;
+  out["max"] = maxValue;
+  out["mean"] = total > 0 ? (uint32_t)(sum / total) : 0;
+  out["p50"] = percentile(50);
+  out["p95"] = percentile(95);
+  out["p99"] = percentile(99);
+  
+  // Only non-empty buckets, for anyone who wants the full shape
+  JsonArray shape = out["buckets"].to<JsonArray>();
+  for (uint8_t i = 0; i < BUCKETS; i++) {
+    if (buckets[i] > 0) {
+      JsonArray bucket = shape.add<JsonArray>();
+      bucket.add(upperBound(i));
+      bucket.add(buckets[i]);
+    }
+  }
+}
+
+void Metrics::reset() {
+  relayMicros.reset();
+  fanOut.reset();
+  bytesIn.reset();
+  bytesOut.reset();
+  loopMicros.reset();
+  httpMicros.reset();
+  lookupMicros.reset();
+  fileKBps.reset();
+}
+
+void Metrics::toJson(JsonObject out) {
+  relayMicros.toJson(out["relayMicros"].to<JsonObject>());
+  fanOut.toJson(out["fanOut"].to<JsonObject>());
+  bytesIn.toJson(out["bytesIn"].to<JsonObject>());
+  bytesOut.toJson(out["bytesOut"].to<JsonObject>());
+  loopMicros.toJson(out["loopMicros"].to<JsonObject>());
+  httpMicros.toJson(out["httpMicros"].to<JsonObject>());
+  lookupMicros.toJson(out["lookupMicros"].to<JsonObject>());
+  fileKBps.toJson(out["fileKBps"].to<JsonObject>());
+}
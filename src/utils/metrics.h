@@ -0,0 +1,59 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Fixed-bucket log-linear histogram. Values below 16 get a bucket each; above
+// that every power of two is split into 8 buckets, so any reported value is
+// within 12.5% of the truth. Values past 2^24 land in the last bucket.
+// ~700 bytes, no allocation, O(1) record.
+class Histogram {
+public:
+  void record(uint32_t value);
+  void reset();
+  
+  uint32_t count() const { return total; }
+  
+  // Upper bound of the bucket holding the p-th percentile (0-100)
+  uint32_t percentile(uint8_t p) const;
+  
+  // { "count", "min", "max", "mean", "p50", "p95", "p99", "buckets": [[upper, count], ...] }
+  void toJson(JsonObject out) const;
+
+private:
+  static const uint8_t SUB_BUCKET_BITS = 3;
+  static const uint8_t LINEAR_BUCKETS = 16;
+  static const uint8_t MAX_BIT = 24;
+  static const uint8_t BUCKETS = LINEAR_BUCKETS + (MAX_BIT - 4) * (1 << SUB_BUCKET_BITS);
+  
+  uint32_t buckets[BUCKETS] = {};
+  uint32_t total = 0;
+  uint64_t sum = 0;
+  uint32_t minValue = UINT32_MAX;
+  uint32_t maxValue = 0;
+  
+  static uint8_t bucketFor(uint32_t value);
+  static uint32_t upperBound(uint8_t bucket);
+};
+
+// Performance histograms shared by the modules that feed them
+class Metrics {
+public:
+  static Histogram relayMicros;   // Message received -> last copy sent or queued (µs)
+  static Histogram fanOut;        // Recipients per relayed message
+  static Histogram bytesIn;       // Size of each message received
+  static Histogram bytesOut;      // Size of each WebSocket frame sent
+  static Histogram loopMicros;    // One pass of the network task, excluding its delay (µs)
+  static Histogram httpMicros;    // HTTP request arrived -> last byte handed to the socket (µs)
+  static Histogram lookupMicros;  // Resolving a request path to a file (µs)
+  static Histogram fileKBps;      // SD -> WiFi throughput of file responses >= 16 KB (KB/s)
+  
+  // Start a fresh measurement window
+  static void reset();
+  
+  // All histograms, keyed by name
+  static void toJson(JsonObject out);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Fixed-size queue from exactly one producer task to one consumer task,
+// usually on different cores. No locks: each side only moves its own
+// counter, so neither can be held up by the other. N must be a power of two.
+template <typename T, size_t N>
+class SpscQueue {
+public:
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+  
+  // Producer side. False (and nothing queued) when full.
+  bool push(const T& item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) {
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+  
+  // Consumer side. False when empty.
+  bool pop(T& item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0};   // Written by the producer only
+  std::atomic<uint32_t> tail{0};   // Written by the consumer only
+};
+
+#endif
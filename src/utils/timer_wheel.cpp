@@ -0,0 +1,78 @@
+#include "timer_wheel.h"
+#include <string.h>
+
+void TimerWheel::init(unsigned long tick, unsigned long now) {
+  tickMs = tick > 0 ? tick : 1;
+  lastTick = now;
+  cursor = 0;
+  memset(heads, NONE, sizeof(heads));
+  memset(slotOf, NONE, sizeof(slotOf));
+}
+
+void TimerWheel::schedule(uint8_t id, unsigned long when) {
+  if (id >= TIMER_WHEEL_CAPACITY) {
+    return;
+  }
+  cancel(id);
+  
+  // Round up so a timer never fires early; anything already due goes in
+  // the next slot
+  long delta = (long)(when - lastTick);
+  unsigned long ticks = delta > 0 ? (delta + tickMs - 1) / tickMs : 1;
+  if (ticks == 0) {
+    ticks = 1;
+  }
+  
+  uint8_t slot = (cursor + ticks) % SLOTS;
+  unsigned long turns = (ticks - 1) / SLOTS;
+  rounds[id] = turns > 0xFFFF ? 0xFFFF : turns;
+  
+  slotOf[id] = slot;
+  prev[id] = NONE;
+  next[id] = heads[slot];
+  if (heads[slot] != NONE) {
+    prev[heads[slot]] = id;
+  }
+  heads[slot] = id;
+}
+
+void TimerWheel::cancel(uint8_t id) {
+  if (id < TIMER_WHEEL_CAPACITY && slotOf[id] != NONE) {
+    unlink(id);
+  }
+}
+
+uint32_t TimerWheel::advance(unsigned long now) {
+  uint32_t fired = 0;
+  
+  while (now - lastTick >= tickMs) {
+    lastTick += tickMs;
+    cursor = (cursor + 1) % SLOTS;
+    
+    uint8_t id = heads[cursor];
+    while (id != NONE) {
+      uint8_t following = next[id];
+      if (rounds[id] == 0) {
+        unlink(id);
+        fired |= (1UL << id);
+      } else {
+        rounds[id]--;
+      }
+      id = following;
+    }
+  }
+  return fired;
+}
+
+void TimerWheel::unlink(uint8_t id) {
+  uint8_t slot = slotOf[id];
+  if (prev[id] != NONE) {
+    next[prev[id]] = next[id];
+  } else {
+    heads[slot] = next[id];
+  }
+  if (next[id] != NONE) {
+    prev[next[id]] = prev[id];
+  }
+  slotOf[id] = NONE;
+}
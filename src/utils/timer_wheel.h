@@ -0,0 +1,47 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Timers are identified by a small id (e.g. a clientNum); fired timers are
+// returned as a bitmask, so ids must fit in 32 bits
+static const uint8_t TIMER_WHEEL_CAPACITY = 32;
+
+// Hashed timer wheel: each timer sits in the slot for its deadline tick, and
+// advancing only visits the slots that come due. Scheduling and cancelling are
+// O(1) list operations on fixed arrays, so nothing is allocated.
+class TimerWheel {
+public:
+  // Set the tick length and start time (call once before scheduling)
+  void init(unsigned long tickMs, unsigned long now);
+  
+  // Fire timer `id` at (or just after) `when`, replacing any pending one
+  void schedule(uint8_t id, unsigned long when);
+  
+  // Drop a pending timer (no-op if none)
+  void cancel(uint8_t id);
+  
+  bool isScheduled(uint8_t id) const { return slotOf[id] != NONE; }
+  
+  // Move time forward; returns the ids whose timers fired
+  uint32_t advance(unsigned long now);
+
+private:
+  static const uint8_t SLOTS = 64;
+  static const uint8_t NONE = 0xFF;
+  
+  uint8_t heads[SLOTS];
+  uint8_t next[TIMER_WHEEL_CAPACITY];
+  uint8_t prev[TIMER_WHEEL_CAPACITY];
+  uint8_t slotOf[TIMER_WHEEL_CAPACITY];
+  uint16_t rounds[TIMER_WHEEL_CAPACITY];   // Full turns left before firing
+  
+  unsigned long tickMs = 0;
+  unsigned long lastTick = 0;
+  uint8_t cursor = 0;
+  
+  void unlink(uint8_t id);
+};
+
+#endif
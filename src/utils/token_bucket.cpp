@@ -0,0 +1,34 @@
+#include "token_bucket.h"
+
+void TokenBucket::reset(uint32_t burst, unsigned long now) {
+  milliTokens = (uint64_t)burst * 1000;
+  lastRefill = now;
+}
+
+void TokenBucket::refill(uint32_t rate, uint32_t burst, unsigned long now) {
+  uint64_t cap = (uint64_t)burst * 1000;
+  unsigned long elapsed = now - lastRefill;
+  lastRefill = now;
+  
+  // rate tokens/s = rate milli-tokens/ms
+  milliTokens += (uint64_t)elapsed * rate;
+  if (milliTokens > cap) {
+    milliTokens = cap;
+  }
+}
+
+bool TokenBucket::canTake(uint32_t cost, uint32_t rate, uint32_t burst, unsigned long now) {
+  refill(rate, burst, now);
+  uint64_t needed = (uint64_t)(cost < burst ? cost : burst) * 1000;
+  return milliTokens >= needed;
+}
+
+bool TokenBucket::take(uint32_t cost, uint32_t rate, uint32_t burst, unsigned long now) {
+  if (!canTake(cost, rate, burst, now)) {
+    return false;
+  }
+  
+  uint64_t spent = (uint64_t)cost * 1000;
+  milliTokens = spent < milliTokens ? milliTokens - spent : 0;
+  return true;
+}
@@ -0,0 +1,30 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Token bucket rate limiter. The rate and burst size are passed on each call
+// so one limit (e.g. per room) can drive many buckets; the bucket itself is
+// just a token count and a timestamp.
+class TokenBucket {
+public:
+  // Start full
+  void reset(uint32_t burst, unsigned long now);
+  
+  // Spend `cost` tokens if there are enough, after refilling at `rate` per
+  // second (capped at `burst`). A cost above `burst` passes when the bucket
+  // is full, so one oversized message isn't blocked forever.
+  bool take(uint32_t cost, uint32_t rate, uint32_t burst, unsigned long now);
+  
+  // Would take() succeed? (refills, spends nothing)
+  bool canTake(uint32_t cost, uint32_t rate, uint32_t burst, unsigned long now);
+
+private:
+  uint64_t milliTokens = 0;   // Tokens x 1000, so slow rates still refill
+  unsigned long lastRefill = 0;
+  
+  void refill(uint32_t rate, uint32_t burst, unsigned long now);
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <zlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "utils/deflate.h"
+
+static DeflateEncoder encoder;
+
+void setUp() {
+  TEST_ASSERT_TRUE(encoder.init());
+}
+
+void tearDown() {}
+
+// What a browser's DecompressionStream('deflate-raw') does: no zlib header
+static std::vector<uint8_t> inflateRaw(const uint8_t* data, size_t length, size_t expected) {
+  std::vector<uint8_t> out(expected + 1);
+  z_stream stream = {};
+  TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&stream, -15));
+  stream.next_in = (Bytef*)data;
+  stream.avail_in = length;
+  stream.next_out = out.data();
+  stream.avail_out = out.size();
+  int result = inflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  TEST_ASSERT_EQUAL(Z_STREAM_END, result);
+  return out;
+}
+
+// Compress, inflate with zlib, compare. Returns the compressed size.
+static size_t roundTrip(const uint8_t* in, size_t length) {
+  // Fixed Huffman codes never take more than 9 bits a byte
+  std::vector<uint8_t> packed(length + length / 8 + 64);
+  size_t size = encoder.compress(in, length, packed.data(), packed.size());
+  TEST_ASSERT_NOT_EQUAL(0, size);
+  
+  std::vector<uint8_t> unpacked = inflateRaw(packed.data(), size, length);
+  TEST_ASSERT_EQUAL_UINT(length, unpacked.size());
+  if (length > 0) {
+    TEST_ASSERT_EQUAL_MEMORY(in, unpacked.data(), length);
+  }
+  return size;
+}
+
+static std::vector<uint8_t> randomBytes(size_t length, uint32_t seed) {
+  std::vector<uint8_t> bytes(length);
+  for (size_t i = 0; i < length; i++) {
+    seed = seed * 1664525UL + 1013904223UL;
+    bytes[i] = seed >> 24;
+  }
+  return bytes;
+}
+
+// The kind of state a game broadcasts
+static std::string gameState(int players) {
+  std::string json = "{\"type\":\"state\",\"tick\":1234,\"players\":[";
+  for (int i = 0; i < players; i++) {
+    if (i > 0) {
+      json += ",";
+    }
+    json += "{\"id\":\"player-" + std::to_string(i) + "\",\"x\":" + std::to_string(i * 7 % 320) +
+            ",\"y\":" + std::to_string(i * 13 % 240) + ",\"score\":0,\"alive\":true}";
+  }
+  json += "]}";
+  return json;
+}
+
+void test_empty_input() {
+  roundTrip((const uint8_t*)"", 0);
+}
+
+void test_short_text() {
+  const char* text = "hello";
+  roundTrip((const uint8_t*)text, strlen(text));
+}
+
+void test_game_state_shrinks() {
+  std::string json = gameState(40);
+  size_t size = roundTrip((const uint8_t*)json.data(), json.size());
+  TEST_ASSERT_LESS_THAN(json.size() / 3, size);
+}
+
+void test_long_run() {
+  // Longest matches (258 bytes) at distance 1
+  std::vector<uint8_t> run(5000, 'a');
+  size_t size = roundTrip(run.data(), run.size());
+  TEST_ASSERT_LESS_THAN(100, size);
+}
+
+void test_random_bytes() {
+  std::vector<uint8_t> bytes = randomBytes(8192, 1);
+  roundTrip(bytes.data(), bytes.size());
+}
+
+void test_repeats_inside_and_beyond_window() {
+  // A block repeated at 3000 bytes (inside the 4 KB window), then at 5000
+  // (outside it: must be sent as literals, not as a reference)
+  std::vector<uint8_t> near = randomBytes(3000, 2);
+  std::vector<uint8_t> far = randomBytes(5000, 3);
+  std::vector<uint8_t> data;
+  data.insert(data.end(), near.begin(), near.end());
+  data.insert(data.end(), near.begin(), near.end());
+  data.insert(data.end(), far.begin(), far.end());
+  data.insert(data.end(), far.begin(), far.end());
+  roundTrip(data.data(), data.size());
+}
+
+void test_largest_input() {
+  std::string json = gameState(1000);
+  json.resize(0xFFFE, ' ');
+  roundTrip((const uint8_t*)json.data(), json.size());
+  
+  // One more and positions no longer fit the tables
+  std::vector<uint8_t> tooBig(0xFFFF, ' ');
+  std::vector<uint8_t> out(0x20000);
+  TEST_ASSERT_EQUAL_UINT(0, encoder.compress(tooBig.data(), tooBig.size(), out.data(), out.size()));
+}
+
+void test_output_must_fit() {
+  // Random data doesn't shrink, so asking for smaller output gets nothing
+  std::vector<uint8_t> bytes = randomBytes(1000, 4);
+  std::vector<uint8_t> out(bytes.size());
+  TEST_ASSERT_EQUAL_UINT(0, encoder.compress(bytes.data(), bytes.size(), out.data(), out.size() - 1));
+}
+
+void test_same_output_every_call() {
+  // Nothing from the previous call leaks into the next
+  std::string first = gameState(20);
+  std::string second = gameState(30);
+  std::vector<uint8_t> a(4096);
+  std::vector<uint8_t> b(4096);
+  size_t sizeA = encoder.compress((const uint8_t*)first.data(), first.size(), a.data(), a.size());
+  encoder.compress((const uint8_t*)second.data(), second.size(), b.data(), b.size());
+  size_t sizeB = encoder.compress((const uint8_t*)first.data(), first.size(), b.data(), b.size());
+  TEST_ASSERT_EQUAL_UINT(sizeA, sizeB);
+  TEST_ASSERT_EQUAL_MEMORY(a.data(), b.data(), sizeA);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_input);
+  RUN_TEST(test_short_text);
+  RUN_TEST(test_game_state_shrinks);
+  RUN_TEST(test_long_run);
+  RUN_TEST(test_random_bytes);
+  RUN_TEST(test_repeats_inside_and_beyond_window);
+  RUN_TEST(test_largest_input);
+  RUN_TEST(test_output_must_fit);
+  RUN_TEST(test_same_output_every_call);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <string.h>
+#include "network/http_request.h"
+
+static HttpRequest request;
+static char block[1024];
+
+void setUp() {}
+
+void tearDown() {}
+
+// parse() cuts the block up, so work on a copy
+static int parse(const char* text) {
+  strncpy(block, text, sizeof(block) - 1);
+  block[sizeof(block) - 1] = '\0';
+  return request.parse(block);
+}
+
+void test_get_with_headers() {
+  TEST_ASSERT_EQUAL(0, parse("GET /games/dice%20roller/index.html?room=poker&game=dice HTTP/1.1\r\n"
+                             "Host: 192.168.4.1\r\n"
+                             "Accept-Encoding: gzip, deflate, br\r\n"
+                             "If-None-Match: \"1a2b-5f00\"\r\n"
+                             "Range: bytes=0-1023\r\n"
+                             "If-Range: \"1a2b-5f00\"\r\n"
+                             "\r\n"));
+  TEST_ASSERT_FALSE(request.head);
+  TEST_ASSERT_TRUE(request.keepAlive);
+  TEST_ASSERT_TRUE(request.acceptsGzip);
+  TEST_ASSERT_EQUAL_STRING("/games/dice roller/index.html", request.path);
+  TEST_ASSERT_EQUAL_STRING("room=poker&game=dice", request.query);
+  TEST_ASSERT_EQUAL_STRING("\"1a2b-5f00\"", request.ifNoneMatch);
+  TEST_ASSERT_EQUAL_STRING("bytes=0-1023", request.range);
+  TEST_ASSERT_EQUAL_STRING("\"1a2b-5f00\"", request.ifRange);
+}
+
+void test_nothing_left_from_last_request() {
+  parse("GET /a.js HTTP/1.1\r\nAccept-Encoding: gzip\r\nRange: bytes=5-\r\n\r\n");
+  TEST_ASSERT_EQUAL(0, parse("GET /b.js HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_FALSE(request.acceptsGzip);
+  TEST_ASSERT_EQUAL_STRING("", request.range);
+  TEST_ASSERT_EQUAL_STRING("", request.query);
+}
+
+void test_header_names_ignore_case() {
+  TEST_ASSERT_EQUAL(0, parse("GET / HTTP/1.1\r\nif-modified-since:Wed, 21 Oct 2015 07:28:00 GMT\r\n"
+                             "CONNECTION: Close\r\n\r\n"));
+  TEST_ASSERT_EQUAL_STRING("Wed, 21 Oct 2015 07:28:00 GMT", request.ifModifiedSince);
+  TEST_ASSERT_FALSE(request.keepAlive);
+}
+
+void test_keep_alive() {
+  TEST_ASSERT_EQUAL(0, parse("GET / HTTP/1.0\r\n\r\n"));
+  TEST_ASSERT_FALSE(request.keepAlive);
+  TEST_ASSERT_EQUAL(0, parse("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"));
+  TEST_ASSERT_TRUE(request.keepAlive);
+  TEST_ASSERT_EQUAL(0, parse("GET / HTTP/1.1\r\nConnection: close\r\n\r\n"));
+  TEST_ASSERT_FALSE(request.keepAlive);
+}
+
+void test_head() {
+  TEST_ASSERT_EQUAL(0, parse("HEAD /song.mp3 HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_TRUE(request.head);
+  TEST_ASSERT_EQUAL_STRING("/song.mp3", request.path);
+}
+
+void test_other_methods() {
+  TEST_ASSERT_EQUAL(405, parse("POST /api/stats HTTP/1.1\r\nContent-Length: 2\r\n\r\n"));
+  TEST_ASSERT_FALSE(request.keepAlive);
+}
+
+void test_malformed_request_line() {
+  TEST_ASSERT_EQUAL(400, parse("GET\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, parse("GET /\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, parse("GET index.html HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, parse("GET /index.html HTTP/1.1"));
+}
+
+void test_percent_decoding() {
+  TEST_ASSERT_EQUAL(0, parse("GET /%41%62c%2 HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL_STRING("/Abc%2", request.path);
+  
+  // A NUL would cut the path short of what was asked for
+  TEST_ASSERT_EQUAL(400, parse("GET /index.html%00.png HTTP/1.1\r\n\r\n"));
+}
+
+void test_too_long() {
+  char text[512];
+  char path[HTTP_PATH_MAX_LENGTH + 2];
+  memset(path, 'a', sizeof(path) - 1);
+  path[0] = '/';
+  path[sizeof(path) - 1] = '\0';
+  snprintf(text, sizeof(text), "GET %s HTTP/1.1\r\n\r\n", path);
+  TEST_ASSERT_EQUAL(414, parse(text));
+  
+  // One shorter fits exactly
+  path[sizeof(path) - 2] = '\0';
+  snprintf(text, sizeof(text), "GET %s HTTP/1.1\r\n\r\n", path);
+  TEST_ASSERT_EQUAL(0, parse(text));
+  
+  char query[HTTP_QUERY_MAX_LENGTH + 2];
+  memset(query, 'q', sizeof(query) - 1);
+  query[sizeof(query) - 1] = '\0';
+  snprintf(text, sizeof(text), "GET /?%s HTTP/1.1\r\n\r\n", query);
+  TEST_ASSERT_EQUAL(414, parse(text));
+}
+
+void test_query_params() {
+  parse("GET /?game=dice&room=poker&gamer=x HTTP/1.1\r\n\r\n");
+  char value[8];
+  TEST_ASSERT_TRUE(request.getParam("room", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("poker", value);
+  TEST_ASSERT_TRUE(request.getParam("game", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("dice", value);
+  TEST_ASSERT_TRUE(request.getParam("gamer", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("x", value);
+  TEST_ASSERT_FALSE(request.getParam("gam", value, sizeof(value)));
+  TEST_ASSERT_FALSE(request.getParam("deflate", value, sizeof(value)));
+  
+  // Cut to fit
+  char small[4];
+  TEST_ASSERT_TRUE(request.getParam("room", small, sizeof(small)));
+  TEST_ASSERT_EQUAL_STRING("pok", small);
+}
+
+static RangeResult range(const char* header, size_t size, size_t& offset, size_t& length) {
+  offset = 12345;
+  length = 12345;
+  return HttpRequest::parseRange(header, size, offset, length);
+}
+
+void test_range_first_last() {
+  size_t offset, length;
+  TEST_ASSERT_TRUE(range("bytes=0-99", 1000, offset, length) == RangeResult::PARTIAL);
+  TEST_ASSERT_EQUAL_UINT(0, offset);
+  TEST_ASSERT_EQUAL_UINT(100, length);
+  
+  // The last byte is clamped to the end of the file
+  TEST_ASSERT_TRUE(range("bytes=900-5000", 1000, offset, length) == RangeResult::PARTIAL);
+  TEST_ASSERT_EQUAL_UINT(900, offset);
+  TEST_ASSERT_EQUAL_UINT(100, length);
+}
+
+void test_range_open_ended() {
+  size_t offset, length;
+  TEST_ASSERT_TRUE(range("bytes=500-", 1000, offset, length) == RangeResult::PARTIAL);
+  TEST_ASSERT_EQUAL_UINT(500, offset);
+  TEST_ASSERT_EQUAL_UINT(500, length);
+}
+
+void test_range_suffix() {
+  size_t offset, length;
+  TEST_ASSERT_TRUE(range("bytes=-100", 1000, offset, length) == RangeResult::PARTIAL);
+  TEST_ASSERT_EQUAL_UINT(900, offset);
+  TEST_ASSERT_EQUAL_UINT(100, length);
+  
+  TEST_ASSERT_TRUE(range("bytes=-2000", 1000, offset, length) == RangeResult::PARTIAL);
+  TEST_ASSERT_EQUAL_UINT(0, offset);
+  TEST_ASSERT_EQUAL_UINT(1000, length);
+}
+
+void test_range_unsatisfiable() {
+  size_t offset, length;
+  TEST_ASSERT_TRUE(range("bytes=1000-", 1000, offset, length) == RangeResult::UNSATISFIABLE);
+  TEST_ASSERT_TRUE(range("bytes=-0", 1000, offset, length) == RangeResult::UNSATISFIABLE);
+  TEST_ASSERT_TRUE(range("bytes=0-", 0, offset, length) == RangeResult::UNSATISFIABLE);
+  TEST_ASSERT_TRUE(range("bytes=-5", 0, offset, length) == RangeResult::UNSATISFIABLE);
+}
+
+void test_range_ignored() {
+  // The whole file is sent instead
+  size_t offset, length;
+  TEST_ASSERT_TRUE(range("bytes=0-1,5-6", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("items=0-1", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("bytes=5-2", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("bytes=100", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("bytes=a-5", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("bytes=1-x", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_TRUE(range("bytes=-", 1000, offset, length) == RangeResult::IGNORED);
+  TEST_ASSERT_EQUAL_UINT(12345, offset);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_get_with_headers);
+  RUN_TEST(test_nothing_left_from_last_request);
+  RUN_TEST(test_header_names_ignore_case);
+  RUN_TEST(test_keep_alive);
+  RUN_TEST(test_head);
+  RUN_TEST(test_other_methods);
+  RUN_TEST(test_malformed_request_line);
+  RUN_TEST(test_percent_decoding);
+  RUN_TEST(test_too_long);
+  RUN_TEST(test_query_params);
+  RUN_TEST(test_range_first_last);
+  RUN_TEST(test_range_open_ended);
+  RUN_TEST(test_range_suffix);
+  RUN_TEST(test_range_unsatisfiable);
+  RUN_TEST(test_range_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,192 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "network/json_scanner.h"
+
+// What relayText looks for, in its order
+static const char* const FIELDS[] = { "type", "to", "snapshot", "stamp", "uuid", "game" };
+
+void setUp() {}
+
+void tearDown() {}
+
+static bool scan(const char* json, JsonSpan* fields, size_t count) {
+  return JsonScanner::scanObject((const uint8_t*)json, strlen(json), FIELDS, fields, count);
+}
+
+// The kind of state a game broadcasts: the uuid comes after the state, so
+// the scanner has to walk the whole message
+static std::string gameState(int players) {
+  std::string json = "{\"type\":\"state\",\"snapshot\":true,\"state\":{\"tick\":1234,\"players\":[";
+  for (int i = 0; i < players; i++) {
+    if (i > 0) {
+      json += ",";
+    }
+    json += "{\"id\":\"player-" + std::to_string(i) + "\",\"x\":" + std::to_string(i * 7 % 320) +
+            ",\"y\":" + std::to_string(i * 13 % 240) + ",\"score\":0,\"alive\":true}";
+  }
+  json += "]},\"uuid\":\"5f0c6a8e-3b7d-4c2a-9e41-0d8b7f6a2c13\"}";
+  return json;
+}
+
+void test_finds_top_level_keys() {
+  JsonSpan fields[6];
+  TEST_ASSERT_TRUE(scan("{ \"uuid\" : \"abc\", \"type\":\"buzz\",\"stamp\":true, \"to\":[\"a\",\"b\"] }", fields, 6));
+  TEST_ASSERT_TRUE(fields[0].equals("buzz"));
+  TEST_ASSERT_EQUAL_UINT(9, fields[1].length);
+  TEST_ASSERT_EQUAL_UINT(4, fields[3].length);
+  TEST_ASSERT_TRUE(fields[4].equals("abc"));
+  TEST_ASSERT_FALSE(fields[2].isPresent());
+  TEST_ASSERT_FALSE(fields[5].isPresent());
+}
+
+void test_skips_nested_values() {
+  // Only the top level counts, whatever is inside the state
+  JsonSpan fields[6];
+  TEST_ASSERT_TRUE(scan("{\"state\":{\"type\":\"x\",\"uuid\":[1,{\"}\":\"]\"}]},\"type\":\"state\"}", fields, 6));
+  TEST_ASSERT_TRUE(fields[0].equals("state"));
+  TEST_ASSERT_FALSE(fields[4].isPresent());
+}
+
+void test_escaped_quotes() {
+  JsonSpan fields[6];
+  TEST_ASSERT_TRUE(scan("{\"msg\":\"say \\\"hi\\\", \\\"uuid\\\":\",\"type\":\"chat\"}", fields, 6));
+  TEST_ASSERT_TRUE(fields[0].equals("chat"));
+  TEST_ASSERT_FALSE(fields[4].isPresent());
+  
+  // Escaped values can't be copied out as they are
+  char out[16];
+  TEST_ASSERT_FALSE(JsonScanner::findString((const uint8_t*)"{\"uuid\":\"a\\\"b\"}", 15, "uuid", out, sizeof(out)));
+}
+
+void test_stops_at_the_frame_length() {
+  const char* json = "{\"type\":\"buzz\",\"uuid\":\"abc\"}";
+  char out[16];
+  TEST_ASSERT_TRUE(JsonScanner::findString((const uint8_t*)json, strlen(json), "uuid", out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("abc", out);
+  for (size_t length = 0; length < strlen(json) - 1; length++) {
+    TEST_ASSERT_FALSE(JsonScanner::findString((const uint8_t*)json, length, "uuid", out, sizeof(out)));
+  }
+}
+
+void test_not_an_object() {
+  JsonSpan fields[6];
+  TEST_ASSERT_FALSE(scan("", fields, 6));
+  TEST_ASSERT_FALSE(scan("[{\"type\":\"x\"}]", fields, 6));
+  TEST_ASSERT_FALSE(scan("hello", fields, 6));
+  TEST_ASSERT_FALSE(scan("{\"type\" \"x\"}", fields, 6));
+  TEST_ASSERT_FALSE(scan("{\"type\":}", fields, 6));
+}
+
+void test_copy_must_fit() {
+  const char* json = "{\"uuid\":\"abcdefgh\"}";
+  char out[9];
+  TEST_ASSERT_TRUE(JsonScanner::findString((const uint8_t*)json, strlen(json), "uuid", out, sizeof(out)));
+  TEST_ASSERT_FALSE(JsonScanner::findString((const uint8_t*)json, strlen(json), "uuid", out, sizeof(out) - 1));
+}
+
+void test_array_elements() {
+  JsonSpan fields[6];
+  TEST_ASSERT_TRUE(scan("{\"to\":[ \"a\" , [1,2], {\"b\":\"]\"} ,3 ]}", fields, 6));
+  size_t cursor = 0;
+  JsonSpan element;
+  TEST_ASSERT_TRUE(JsonScanner::nextElement(fields[1], cursor, element));
+  TEST_ASSERT_TRUE(element.equals("a"));
+  TEST_ASSERT_TRUE(JsonScanner::nextElement(fields[1], cursor, element));
+  TEST_ASSERT_EQUAL_UINT(5, element.length);
+  TEST_ASSERT_TRUE(JsonScanner::nextElement(fields[1], cursor, element));
+  TEST_ASSERT_EQUAL_UINT(9, element.length);
+  TEST_ASSERT_TRUE(JsonScanner::nextElement(fields[1], cursor, element));
+  TEST_ASSERT_EQUAL_UINT(1, element.length);
+  TEST_ASSERT_FALSE(JsonScanner::nextElement(fields[1], cursor, element));
+}
+
+void test_same_uuid_as_arduinojson() {
+  std::string state = gameState(40);
+  const char* frames[] = {
+    "{\"type\":\"buzz\",\"uuid\":\"abc\",\"stamp\":true}",
+    "{\"type\":\"deal\",\"uuid\":\"abc\",\"to\":\"def\",\"cards\":[{\"uuid\":\"x\"}]}",
+    "{\"type\":\"relay_join\",\"room\":\"dice\"}",
+    state.c_str(),
+  };
+  for (const char* frame : frames) {
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, frame, strlen(frame)));
+    char uuid[64];
+    bool found = JsonScanner::findString((const uint8_t*)frame, strlen(frame), "uuid", uuid, sizeof(uuid));
+    TEST_ASSERT_EQUAL(doc["uuid"].is<const char*>(), found);
+    if (found) {
+      TEST_ASSERT_EQUAL_STRING(doc["uuid"].as<const char*>(), uuid);
+    }
+  }
+}
+
+// Keeps the timed work from being optimised away
+static volatile size_t sink;
+
+// Time per call of fn(frame), in microseconds
+template <typename Fn>
+static double timeFrame(const std::string& frame, int runs, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    fn((const uint8_t*)frame.data(), frame.size());
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / runs;
+}
+
+// Not a pass/fail test: prints the cost of the old relayText parse (a
+// JsonDocument per frame, as before the scanner) next to the scans that
+// replaced it. Host numbers, so only the ratio carries over to the board.
+void test_benchmark_against_arduinojson() {
+  const int RUNS = 20000;
+  const std::string frames[] = {
+    "{\"type\":\"buzz\",\"uuid\":\"5f0c6a8e-3b7d-4c2a-9e41-0d8b7f6a2c13\",\"stamp\":true}",
+    gameState(30),
+  };
+  
+  for (const std::string& frame : frames) {
+    double parse = timeFrame(frame, RUNS, [](const uint8_t* payload, size_t length) {
+      JsonDocument doc;
+      if (!deserializeJson(doc, (const char*)payload, length) && doc["uuid"].is<const char*>()) {
+        sink = strlen(doc["uuid"].as<const char*>());
+      }
+    });
+    
+    // An unregistered client looks for all six keys, a registered one for four
+    double unregistered = timeFrame(frame, RUNS, [](const uint8_t* payload, size_t length) {
+      JsonSpan fields[6];
+      JsonScanner::scanObject(payload, length, FIELDS, fields, 6);
+      sink = fields[4].length;
+    });
+    double registered = timeFrame(frame, RUNS, [](const uint8_t* payload, size_t length) {
+      JsonSpan fields[4];
+      JsonScanner::scanObject(payload, length, FIELDS, fields, 4);
+      sink = fields[0].length;
+    });
+    
+    char message[128];
+    snprintf(message, sizeof(message), "%u-byte frame: deserializeJson %.2f us, scan %.2f us (unregistered), %.2f us (registered)",
+             (unsigned)frame.size(), parse, unregistered, registered);
+    TEST_MESSAGE(message);
+  }
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_finds_top_level_keys);
+  RUN_TEST(test_skips_nested_values);
+  RUN_TEST(test_escaped_quotes);
+  RUN_TEST(test_stops_at_the_frame_length);
+  RUN_TEST(test_not_an_object);
+  RUN_TEST(test_copy_must_fit);
+  RUN_TEST(test_array_elements);
+  RUN_TEST(test_same_uuid_as_arduinojson);
+  RUN_TEST(test_benchmark_against_arduinojson);
+  return UNITY_END();
+}
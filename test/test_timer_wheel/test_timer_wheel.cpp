@@ -0,0 +1,105 @@
+#include <unity.h>
+#include "utils/timer_wheel.h"
+
+static const unsigned long TICK_MS = 10;
+static const unsigned long START = 1000;
+
+static TimerWheel wheel;
+
+void setUp() {
+  wheel.init(TICK_MS, START);
+}
+
+void tearDown() {}
+
+static uint32_t bit(uint8_t id) {
+  return 1UL << id;
+}
+
+void test_fires_at_deadline() {
+  wheel.schedule(3, START + 50);
+  TEST_ASSERT_TRUE(wheel.isScheduled(3));
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 49));
+  TEST_ASSERT_EQUAL_UINT32(bit(3), wheel.advance(START + 50));
+  TEST_ASSERT_FALSE(wheel.isScheduled(3));
+  
+  // Only once
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 1000));
+}
+
+void test_never_early() {
+  // Between ticks: rounded up to the next one
+  wheel.schedule(1, START + 5);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 9));
+  TEST_ASSERT_EQUAL_UINT32(bit(1), wheel.advance(START + 10));
+}
+
+void test_already_due() {
+  wheel.schedule(2, START - 500);
+  TEST_ASSERT_EQUAL_UINT32(bit(2), wheel.advance(START + TICK_MS));
+}
+
+void test_cancel() {
+  wheel.schedule(4, START + 20);
+  wheel.cancel(4);
+  TEST_ASSERT_FALSE(wheel.isScheduled(4));
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 100));
+  
+  // Cancelling nothing is fine
+  wheel.cancel(4);
+  wheel.cancel(200);
+}
+
+void test_reschedule_replaces() {
+  wheel.schedule(5, START + 20);
+  wheel.schedule(5, START + 100);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 90));
+  TEST_ASSERT_EQUAL_UINT32(bit(5), wheel.advance(START + 100));
+}
+
+void test_more_than_one_turn() {
+  // 64 slots of 10 ms: this one goes round the wheel several times first
+  wheel.schedule(6, START + 2000);
+  wheel.schedule(7, START + 2000 - 64 * TICK_MS);
+  TEST_ASSERT_EQUAL_UINT32(bit(7), wheel.advance(START + 2000 - 64 * TICK_MS));
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 1990));
+  TEST_ASSERT_EQUAL_UINT32(bit(6), wheel.advance(START + 2000));
+}
+
+void test_shared_slot() {
+  for (uint8_t id = 0; id < TIMER_WHEEL_CAPACITY; id++) {
+    wheel.schedule(id, START + 30);
+  }
+  wheel.cancel(17);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL & ~bit(17), wheel.advance(START + 30));
+}
+
+void test_jump_fires_everything_due() {
+  wheel.schedule(0, START + 10);
+  wheel.schedule(9, START + 700);
+  wheel.schedule(31, START + 5000);
+  TEST_ASSERT_EQUAL_UINT32(bit(0) | bit(9), wheel.advance(START + 4000));
+  TEST_ASSERT_TRUE(wheel.isScheduled(31));
+  TEST_ASSERT_EQUAL_UINT32(bit(31), wheel.advance(START + 5000));
+}
+
+void test_ids_out_of_range() {
+  wheel.schedule(TIMER_WHEEL_CAPACITY, START + 10);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel.advance(START + 100));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_fires_at_deadline);
+  RUN_TEST(test_never_early);
+  RUN_TEST(test_already_due);
+  RUN_TEST(test_cancel);
+  RUN_TEST(test_reschedule_replaces);
+  RUN_TEST(test_more_than_one_turn);
+  RUN_TEST(test_shared_slot);
+  RUN_TEST(test_jump_fires_everything_due);
+  RUN_TEST(test_ids_out_of_range);
+  return UNITY_END();
+}
@@ -0,0 +1,82 @@
+#include <unity.h>
+#include "utils/token_bucket.h"
+
+static TokenBucket bucket;
+
+void setUp() {
+  bucket.reset(5, 0);
+}
+
+void tearDown() {}
+
+void test_starts_full() {
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(bucket.take(1, 1, 5, 0));
+  }
+  TEST_ASSERT_FALSE(bucket.take(1, 1, 5, 0));
+}
+
+void test_refills_at_rate() {
+  TEST_ASSERT_TRUE(bucket.take(5, 2, 5, 0));
+  TEST_ASSERT_FALSE(bucket.take(1, 2, 5, 499));
+  TEST_ASSERT_TRUE(bucket.take(1, 2, 5, 500));
+  TEST_ASSERT_FALSE(bucket.take(1, 2, 5, 500));
+  TEST_ASSERT_TRUE(bucket.take(2, 2, 5, 1500));
+}
+
+void test_capped_at_burst() {
+  TEST_ASSERT_TRUE(bucket.take(5, 10, 5, 0));
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(bucket.take(1, 10, 5, 100000));
+  }
+  TEST_ASSERT_FALSE(bucket.take(1, 10, 5, 100000));
+}
+
+void test_slow_rates_refill() {
+  // Under one token per refill: the fraction is kept, not rounded away
+  TEST_ASSERT_TRUE(bucket.take(5, 1, 5, 0));
+  for (unsigned long now = 100; now < 1000; now += 100) {
+    TEST_ASSERT_FALSE(bucket.take(1, 1, 5, now));
+  }
+  TEST_ASSERT_TRUE(bucket.take(1, 1, 5, 1000));
+}
+
+void test_byte_costs() {
+  // 1000 bytes/s with a one-second burst, as the relay's byte limit
+  bucket.reset(1000, 0);
+  TEST_ASSERT_TRUE(bucket.take(600, 1000, 1000, 0));
+  TEST_ASSERT_FALSE(bucket.take(600, 1000, 1000, 0));
+  TEST_ASSERT_TRUE(bucket.take(600, 1000, 1000, 200));
+}
+
+void test_oversized_cost_passes_when_full() {
+  // One message bigger than the burst isn't blocked forever...
+  TEST_ASSERT_TRUE(bucket.take(100, 5, 5, 0));
+  
+  // ...but it empties the bucket
+  TEST_ASSERT_FALSE(bucket.take(1, 5, 5, 0));
+  TEST_ASSERT_FALSE(bucket.take(100, 5, 5, 999));
+  TEST_ASSERT_TRUE(bucket.take(100, 5, 5, 1000));
+}
+
+void test_can_take_spends_nothing() {
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_TRUE(bucket.canTake(5, 1, 5, 0));
+  }
+  TEST_ASSERT_TRUE(bucket.take(5, 1, 5, 0));
+  TEST_ASSERT_FALSE(bucket.canTake(1, 1, 5, 0));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_full);
+  RUN_TEST(test_refills_at_rate);
+  RUN_TEST(test_capped_at_burst);
+  RUN_TEST(test_slow_rates_refill);
+  RUN_TEST(test_byte_costs);
+  RUN_TEST(test_oversized_cost_passes_when_full);
+  RUN_TEST(test_can_take_spends_nothing);
+  return UNITY_END();
+}
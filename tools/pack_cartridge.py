@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Pack a cartridge folder into a single .lpa file for the ESP32 web server.
+
+The server then finds every file of the game through one index read at first
+use and one seek per request, instead of walking FAT directories and opening
+each small file. Copy the .lpa into /games on the SD card in place of (or
+beside) the folder; swapping a game means copying one file.
+
+    python tools/pack_cartridge.py MiniSD/games/my_game
+    python tools/pack_cartridge.py MiniSD/games/my_game --gzip -o /Volumes/SD/games
+
+Layout (little-endian), matching src/storage/cartridge.h:
+
+    header  "LPA1", u16 version, u16 entry count, 8 bytes reserved
+    index   per file: u32 path hash (FNV-1a), u32 path check (djb2),
+            u32 offset, u32 length, u32 CRC-32, u8 flags (1 = gzip),
+            3 bytes reserved - sorted by path hash, then check
+    data    each file starting on a 512-byte (SD sector) boundary
+"""
+
+import argparse
+import gzip
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b'LPA1'
+VERSION = 2
+HEADER = struct.Struct('<4sHH8x')
+ENTRY = struct.Struct('<IIIIIB3x')
+SECTOR = 512
+MAX_ENTRIES = 1024
+FLAG_GZIP = 0x01
+COMPRESSIBLE = ('.html', '.css', '.js', '.json', '.svg')
+
+
+def fnv1a(text):
+    h = 2166136261
+    for byte in text.encode('utf-8'):
+        h = ((h ^ byte) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def djb2(text):
+    h = 5381
+    for byte in text.encode('utf-8'):
+        h = (h * 33 + byte) & 0xFFFFFFFF
+    return h
+
+
+def collect(folder, add_gzip, min_size):
+    """Map of served path ("/index.html") -> (data, flags)"""
+    files = {}
+    for root, dirs, names in os.walk(folder):
+        dirs[:] = sorted(d for d in dirs if not d.startswith('.'))
+        for name in sorted(names):
+            if name.startswith('.'):
+                continue
+            full = os.path.join(root, name)
+            path = '/' + os.path.relpath(full, folder).replace(os.sep, '/')
+            with open(full, 'rb') as f:
+                data = f.read()
+            # foo.js.gz from pack_gzip.py is served as foo.js with Content-Encoding
+            flags = FLAG_GZIP if path.lower().endswith(tuple(e + '.gz' for e in COMPRESSIBLE)) else 0
+            files[path] = (data, flags)
+
+    if add_gzip:
+        for path, (data, flags) in list(files.items()):
+            if flags or not path.lower().endswith(COMPRESSIBLE) or len(data) < min_size:
+                continue
+            if path + '.gz' in files:
+                continue
+            # mtime=0 keeps the output identical between runs
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(packed) < len(data):
+                files[path + '.gz'] = (packed, FLAG_GZIP)
+    return files
+
+
+def pack(folder, output, add_gzip, min_size):
+    files = collect(folder, add_gzip, min_size)
+    if not files:
+        raise ValueError(f'{folder} has no files')
+    if len(files) > MAX_ENTRIES:
+        raise ValueError(f'{len(files)} files - a cartridge holds at most {MAX_ENTRIES}')
+    if '/manifest.json' not in files:
+        print(f'Warning: {folder} has no manifest.json - the game will use defaults', file=sys.stderr)
+
+    # The server only keeps the two hashes, so paths that share both can't be told apart
+    by_hash = {}
+    for path in files:
+        key = (fnv1a(path), djb2(path))
+        if key in by_hash:
+            raise ValueError(f'{path} and {by_hash[key]} have the same hashes - rename one')
+        by_hash[key] = path
+
+    entries = []
+    offset = HEADER.size + ENTRY.size * len(files)
+    for key in sorted(by_hash):
+        data, flags = files[by_hash[key]]
+        offset = (offset + SECTOR - 1) // SECTOR * SECTOR
+        entries.append((key, offset, data, flags))
+        offset += len(data)
+
+    with open(output, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, VERSION, len(entries)))
+        for (h, check), start, data, flags in entries:
+            f.write(ENTRY.pack(h, check, start, len(data), zlib.crc32(data) & 0xFFFFFFFF, flags))
+        for _, start, data, _ in entries:
+            f.write(b'\0' * (start - f.tell()))
+            f.write(data)
+    return len(entries), offset
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('folders', nargs='+', help='cartridge folders to pack (MiniSD/games/<name>)')
+    parser.add_argument('-o', '--output-dir',
+                        help='where to write <name>.lpa (default: next to the folder)')
+    parser.add_argument('--gzip', action='store_true',
+                        help='also store gzipped copies of .html/.css/.js/.json/.svg files')
+    parser.add_argument('--min-size', type=int, default=256,
+                        help='with --gzip, leave files smaller than this uncompressed (default 256 bytes)')
+    args = parser.parse_args()
+
+    for folder in args.folders:
+        folder = os.path.normpath(folder)
+        if not os.path.isdir(folder):
+            print(f'Not a folder: {folder}', file=sys.stderr)
+            return 1
+
+        name = os.path.basename(folder)
+        output_dir = args.output_dir or os.path.dirname(folder)
+        output = os.path.join(output_dir, name + '.lpa')
+        try:
+            count, size = pack(folder, output, args.gzip, args.min_size)
+        except ValueError as e:
+            print(f'{folder}: {e}', file=sys.stderr)
+            return 1
+        print(f'{output}: {count} files, {size} bytes')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
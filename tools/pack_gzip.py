@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Precompress a cartridge's text files for the ESP32 web server.
+
+Writes foo.js.gz next to every .html/.css/.js/.json/.svg file in the given
+folders. Browsers that accept gzip get the .gz (a third to a fifth of the
+size, so less to read from the SD card and less to send over WiFi); anything
+else still gets the original, so keep both on the card.
+
+    python tools/pack_gzip.py MiniSD
+    python tools/pack_gzip.py MiniSD/games/my_game --min-size 512
+"""
+
+import argparse
+import gzip
+import os
+import sys
+
+COMPRESSIBLE = ('.html', '.css', '.js', '.json', '.svg')
+
+
+def pack_file(path, min_size, force):
+    gz_path = path + '.gz'
+    size = os.path.getsize(path)
+    if size < min_size:
+        return None
+
+    # Skip files whose .gz is already up to date
+    if not force and os.path.exists(gz_path) and os.path.getmtime(gz_path) >= os.path.getmtime(path):
+        return None
+
+    with open(path, 'rb') as f:
+        data = f.read()
+    # mtime=0 keeps the output identical between runs
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+
+    # Not worth it: the server would just send more bytes
+    if len(packed) >= size:
+        if os.path.exists(gz_path):
+            os.remove(gz_path)
+        return None
+
+    with open(gz_path, 'wb') as f:
+        f.write(packed)
+    return size, len(packed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('folders', nargs='+', help='SD card or cartridge folders to pack')
+    parser.add_argument('--min-size', type=int, default=256,
+                        help='leave files smaller than this uncompressed (default 256 bytes)')
+    parser.add_argument('--force', action='store_true', help='rebuild .gz files even if up to date')
+    args = parser.parse_args()
+
+    total_in = total_out = count = 0
+    for folder in args.folders:
+        if not os.path.isdir(folder):
+            print(f'Not a folder: {folder}', file=sys.stderr)
+            return 1
+
+        for root, _, files in os.walk(folder):
+            for name in sorted(files):
+                if not name.lower().endswith(COMPRESSIBLE):
+                    continue
+                path = os.path.join(root, name)
+                result = pack_file(path, args.min_size, args.force)
+                if result is None:
+                    continue
+                size, packed = result
+                total_in += size
+                total_out += packed
+                count += 1
+                print(f'{path}: {size} -> {packed} bytes ({packed * 100 // size}%)')
+
+    if count:
+        print(f'Packed {count} files: {total_in} -> {total_out} bytes')
+    else:
+        print('Nothing to pack')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())